@@ -41,6 +41,14 @@ public class AnimatedTexture : ModuleRules
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
+
+		// the cook asks the target platform whether it can memory map the GIF data, reads its memory budget
+		// and checks it samples BC1/BC3 textures, compressed frames are cached in the DDC
+		if (Target.bBuildEditor)
+		{
+			PrivateIncludePathModuleNames.Add("TargetPlatform");
+			PrivateDependencyModuleNames.Add("DerivedDataCache");
+		}
 		
 		
 		DynamicallyLoadedModuleNames.AddRange(
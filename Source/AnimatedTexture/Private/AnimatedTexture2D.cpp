@@ -1,79 +1,154 @@
 // Copyright 2019 Neil Fang. All Rights Reserved.
 
 #include "AnimatedTexture2D.h"
+#include "AnimatedTexturePlayer.h"
 #include "AnimatedTextureResource.h"
-#include "gif_load/gif_load.h" // from: https://github.com/hidefromkgb/gif_load
+#include "AnimatedTextureCustomVersion.h"
+#include "AnimatedTextureManager.h"
+#include "AnimatedTextureMipChain.h"
+#include "AnimatedTextureCompositor.h"
+#include "AnimatedTextureModule.h"
+#include "BCEncoder.h"
+#include "GIFDecoder.h"
+
+#include "Serialization/CustomVersion.h"	// Core
+#include "HAL/IConsoleManager.h"	// Core
+#include "Async/AsyncWork.h"	// Core
+#include "Async/Async.h"	// Core
+#include "RenderingThread.h"	// RenderCore
+#include "Algo/BinarySearch.h"	// Core
+#if WITH_EDITOR
+#include "Interfaces/ITargetPlatform.h"	// TargetPlatform
+#include "DerivedDataCacheInterface.h"	// DerivedDataCache
+#include "Serialization/MemoryReader.h"	// Core
+#include "Serialization/MemoryWriter.h"	// Core
+#include "Misc/SecureHash.h"	// Core
+#endif
+
+const FGuid FAnimatedTextureCustomVersion::GUID(0x6F1E2A47, 0x3C5B4D21, 0x9A8E0F73, 0x52D4B6C1);
+FCustomVersionRegistration GRegisterAnimatedTextureCustomVersion(FAnimatedTextureCustomVersion::GUID, FAnimatedTextureCustomVersion::LatestVersion, TEXT("AnimatedTextureVer"));
 
 bool isGifData(const void* data) {
 	return FMemory::Memcmp(data, "GIF", 3) == 0;
 }
 
-
-//ANIMATEDTEXTURE_API bool LoadGIFBinary(UAnimatedTexture2D* OutGIF, const uint8* Buffer, uint32 BufferSize);
-
-void GIFFrameLoader1(void* data, struct GIF_WHDR* whdr)
+FArchive& operator<<(FArchive& Ar, FGIFFrame& Frame)
 {
-	UAnimatedTexture2D* OutGIF = (UAnimatedTexture2D*)data;
-
-	//-- init on first frame
-	if (OutGIF->GetFrameCount() == 0) {
-		OutGIF->Import_Init(whdr->xdim, whdr->ydim, whdr->bkgd, whdr->nfrm);
-	}
+	Ar << Frame.Time << Frame.Index;
+	Ar << Frame.Width << Frame.Height << Frame.OffsetX << Frame.OffsetY;
+	Ar << Frame.Interlacing << Frame.Mode << Frame.TransparentIndex;
+	Frame.PixelIndices.BulkSerialize(Ar);
+	Ar << Frame.PaletteIndex;
+	Ar << Frame.DataOffset;
+	return Ar;
+}
 
-	//-- import frame
-	int FrameIndex = whdr->ifrm;
+/** Frame table of cooked packages saved before FAnimatedTextureCustomVersion::SharedPalettes */
+static void SerializeLegacyFrames(FArchive& Ar, TArray<FGIFFrame>& Frames, TArray<FColor>& Palettes)
+{
+	check(Ar.IsLoading());
 
-	check(OutGIF->GetFrameCount() == whdr->nfrm);
-	check(FrameIndex >= 0 && FrameIndex < OutGIF->GetFrameCount());
+	FGIFParseResult Result;
+	int32 NumFrames = 0;
+	Ar << NumFrames;
+	Frames.SetNum(NumFrames);
 
-	FGIFFrame& Frame = OutGIF->GetFrame(FrameIndex);
+	for (FGIFFrame& Frame : Frames)
+	{
+		TArray<FColor> Palette;
+		Ar << Frame.Time << Frame.Index;
+		Ar << Frame.Width << Frame.Height << Frame.OffsetX << Frame.OffsetY;
+		Ar << Frame.Interlacing << Frame.Mode << Frame.TransparentIndex;
+		Frame.PixelIndices.BulkSerialize(Ar);
+		Ar << Palette;
+		if (Ar.CustomVer(FAnimatedTextureCustomVersion::GUID) >= FAnimatedTextureCustomVersion::FrameDataOffset)
+			Ar << Frame.DataOffset;
 
-	//-- copy properties
-	if (whdr->time >= 0)
-		Frame.Time = whdr->time * 0.01f;	// 1 GIF time units = 10 msec
-	else
-		Frame.Time = (-whdr->time - 1) * 0.01f;
-
-	/** [TODO:] the frame is assumed to be inside global bounds,
-			however it might exceed them in some GIFs; fix me. **/
-	Frame.Index = whdr->ifrm;
-	Frame.Width = whdr->frxd;
-	Frame.Height = whdr->fryd;
-	Frame.OffsetX = whdr->frxo;
-	Frame.OffsetY = whdr->fryo;
-	Frame.Interlacing = whdr->intr != 0;
-	Frame.Mode = whdr->mode;
-	Frame.TransparentIndex = whdr->tran;
-
-	//-- copy pixel data
-	int NumPixel = Frame.Width * Frame.Height;
-	Frame.PixelIndices.SetNumUninitialized(NumPixel);
-	FMemory::Memcpy(Frame.PixelIndices.GetData(), whdr->bptr, NumPixel);
-
-	//-- copy pal
-	int PaletteSize = whdr->clrs;
-	Frame.Palette.Init(FColor(0, 0, 0, 255), PaletteSize);
-	for (int i = 0; i < PaletteSize; i++)
-	{
-		FColor& uc = Frame.Palette[i];
-		uc.R = whdr->cpal[i].R;
-		uc.G = whdr->cpal[i].G;
-		uc.B = whdr->cpal[i].B;
+		int32 NumColors = FMath::Min(Palette.Num(), GIF_PALETTE_COLORS);
+		Palette.SetNum(GIF_PALETTE_COLORS);
+		for (int32 i = NumColors; i < GIF_PALETTE_COLORS; i++)
+			Palette[i] = FColor(0, 0, 0, 255);
+		if (Frame.TransparentIndex >= 0 && Frame.TransparentIndex < GIF_PALETTE_COLORS)
+			Palette[Frame.TransparentIndex].A = 0;
+		Frame.PaletteIndex = Result.AddPalette(Palette.GetData());
 	}// end of for
+
+	Palettes = MoveTemp(Result.Palettes);
 }
 
+static TAutoConsoleVariable<int32> CVarAnimatedTexturePreUploadMaxBytes(
+	TEXT("r.AnimatedTexture.PreUploadMaxBytes"),
+	4 * 1024 * 1024,
+	TEXT("Animated textures in Auto upload mode keep every frame on the GPU when all frames fit in this many bytes."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAnimatedTexturePreUploadMaxFrames(
+	TEXT("r.AnimatedTexture.PreUploadMaxFrames"),
+	64,
+	TEXT("Animated textures in Auto upload mode keep every frame on the GPU when they have at most this many frames."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAnimatedTextureAsyncParse(
+	TEXT("r.AnimatedTexture.AsyncParse"),
+	1,
+	TEXT("Parse the GIF data of loaded animated textures on a worker thread.\n")
+	TEXT("The texture shows its background color until the first frame is ready."),
+	ECVF_Default);
 
-bool LoadGIFBinary(UAnimatedTexture2D* OutGIF, const uint8* Buffer, uint32 BufferSize)
+/**
+ * Load and parse the GIF file on a pool thread, the texture picks up the result on the game thread
+ */
+class FGIFParseTask : public FNonAbandonableTask
 {
-	int Ret = GIF_Load((void*)Buffer, BufferSize, GIFFrameLoader1, 0, (void*)OutGIF, 0L);
-	OutGIF->Import_Finished();
+public:
+	FGIFParseTask(UAnimatedTexture2D* InOwner, FByteBulkData& InGIFData, TUniquePtr<FOwnedBulkDataPtr>& InResidentGIF, int32& InResidentGIFSize, bool bInScanOnly, bool bInKeepGIFData)
+		:Owner(InOwner), GIFData(InGIFData), ResidentGIF(InResidentGIF), ResidentGIFSize(InResidentGIFSize), bScanOnly(bInScanOnly), bKeepGIFData(bInKeepGIFData), bSucceeded(false)
+	{}
 
-	if (Ret < 0) {
-		UE_LOG(LogTexture, Warning, TEXT("gif format error."));
-		return false;
+	void DoWork()
+	{
+		// no-op if the game thread already loaded it
+		UAnimatedTexture2D::AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+
+		const uint8* Buffer = ResidentGIF.IsValid() ? (const uint8*)ResidentGIF->GetPointer() : nullptr;
+		if (Buffer == nullptr)
+			bSucceeded = false;
+		else if (bScanOnly)
+			bSucceeded = ScanGIFBinary(Result, Buffer, ResidentGIFSize);
+		else
+			bSucceeded = LoadGIFBinary(Result, Buffer, ResidentGIFSize);
+
+		if (!bKeepGIFData)
+		{
+			ResidentGIF.Reset();
+			ResidentGIFSize = 0;
+		}
+
+		TWeakObjectPtr<UAnimatedTexture2D> WeakOwner = Owner;
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner]()
+		{
+			if (UAnimatedTexture2D* Texture = WeakOwner.Get())
+				Texture->FinishAsyncParse();
+		});
 	}
-	return true;
-}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FGIFParseTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+	TWeakObjectPtr<UAnimatedTexture2D> Owner;
+
+	// owner waits for the task before touching them
+	FByteBulkData& GIFData;
+	TUniquePtr<FOwnedBulkDataPtr>& ResidentGIF;
+	int32& ResidentGIFSize;
+
+	bool bScanOnly;
+	bool bKeepGIFData;
+	FGIFParseResult Result;
+	bool bSucceeded;
+};
 
 float UAnimatedTexture2D::GetSurfaceWidth() const
 {
@@ -87,7 +162,8 @@ float UAnimatedTexture2D::GetSurfaceHeight() const
 
 FTextureResource* UAnimatedTexture2D::CreateResource()
 {
-	FTextureResource* NewResource = new FAnimatedTextureResource(this);
+	FAnimatedTexturePlaybackSettings Settings(PlayRate, MaxUpdateRate, IsPlaying(), bLooping, bAlwaysTickEvenNoSee);
+	FTextureResource* NewResource = new FAnimatedTextureResource(this, this, Settings);
 	return NewResource;
 }
 
@@ -97,11 +173,16 @@ uint32 UAnimatedTexture2D::CalcTextureMemorySizeEnum(ETextureMipCount Enum) cons
 	{
 
 		uint32 Flags = SRGB ? TexCreate_SRGB : 0;
-		uint32 NumMips = 1;
+		uint32 NumMips = GetCanvasMipCount();
 		uint32 NumSamples = 1;
 		uint32 TextureAlign;
 		FRHIResourceCreateInfo CreateInfo;
-		uint32 Size = (uint32)RHICalcTexture2DPlatformSize(GlobalWidth, GlobalHeight, PF_B8G8R8A8, 1, 1, (ETextureCreateFlags)Flags, FRHIResourceCreateInfo(), TextureAlign);
+		EPixelFormat Format = HasCompressedFrames() ? GetCompressedFormat() : PF_B8G8R8A8;
+		uint32 Size = (uint32)RHICalcTexture2DPlatformSize(GlobalWidth, GlobalHeight, Format, NumMips, NumSamples, (ETextureCreateFlags)Flags, FRHIResourceCreateInfo(), TextureAlign);
+		if (UsesPreUploadedFrames())
+			Size *= Frames.Num();
+		else
+			Size *= GetTextureBufferCount();
 
 		return Size;
 	}
@@ -109,6 +190,13 @@ uint32 UAnimatedTexture2D::CalcTextureMemorySizeEnum(ETextureMipCount Enum) cons
 	return 4;
 }
 
+int32 UAnimatedTexture2D::GetCanvasMipCount() const
+{
+	if (HasCompressedFrames())
+		return CompressedMipCount;
+	return bGenerateMips ? FAnimatedTextureMipChain::CalcNumMips(GlobalWidth, GlobalHeight) : 1;
+}
+
 #if WITH_EDITOR
 void UAnimatedTexture2D::PostEditChangeProperty(FPropertyChangedEvent & PropertyChangedEvent)
 {
@@ -123,12 +211,38 @@ void UAnimatedTexture2D::PostEditChangeProperty(FPropertyChangedEvent & Property
 		const FName PropertyName = PropertyThatChanged->GetFName();
 
 		static const FName SupportsTransparencyName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, SupportsTransparency);
+		static const FName DecodeFramesOnDemandName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, bDecodeFramesOnDemand);
+		static const FName DefaultFrameDelayName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, DefaultFrameDelay);
+		static const FName PlayRateName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, PlayRate);
+		static const FName LoopingName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, bLooping);
+		static const FName AlwaysTickEvenNoSeeName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, bAlwaysTickEvenNoSee);
+		static const FName MaxUpdateRateName = GET_MEMBER_NAME_CHECKED(UAnimatedTexture2D, MaxUpdateRate);
 
 		if (PropertyName == SupportsTransparencyName)
 		{
 			RequiresNotifyMaterials = true;
 			ResetAnimState = true;
 		}
+		else if (PropertyName == DecodeFramesOnDemandName)
+		{
+			// the render thread reads the frames while playing
+			ReleaseResource();
+			FlushRenderingCommands();
+
+			ParseGIFData();
+			UpdateResource();
+		}
+		else if (PropertyName == DefaultFrameDelayName)
+		{
+			FlushRenderingCommands();
+			BuildFrameStartTimes();
+		}
+		else if (PropertyName == PlayRateName || PropertyName == LoopingName
+			|| PropertyName == AlwaysTickEvenNoSeeName || PropertyName == MaxUpdateRateName)
+		{
+			// the playing resource keeps its own copy, as with the blueprint setters
+			UpdatePlaybackSettings();
+		}
 	}// end of if(prop is valid)
 
 	if (ResetAnimState)
@@ -140,6 +254,21 @@ void UAnimatedTexture2D::PostEditChangeProperty(FPropertyChangedEvent & Property
 	if (RequiresNotifyMaterials)
 		NotifyMaterials();
 }
+
+void UAnimatedTexture2D::ClearCachedCookedPlatformData(const ITargetPlatform* TargetPlatform)
+{
+	Super::ClearCachedCookedPlatformData(TargetPlatform);
+
+	// the editor never plays the compressed frames, the next cook gets them back from the DDC
+	CompressedFrameData.RemoveBulkData();
+}
+
+void UAnimatedTexture2D::ClearAllCachedCookedPlatformData()
+{
+	Super::ClearAllCachedCookedPlatformData();
+
+	CompressedFrameData.RemoveBulkData();
+}
 #endif // WITH_EDITOR
 
 void UAnimatedTexture2D::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
@@ -148,18 +277,46 @@ void UAnimatedTexture2D::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSi
 
 	//if (CumulativeResourceSize.GetResourceSizeMode() == EResourceSizeMode::Exclusive)
 	{
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetGIFDataSize());
 		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Frames.GetAllocatedSize());
-
-		for (auto& Frame: Frames)
-		{
-			CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Frame.Palette.GetAllocatedSize());
-			CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Frame.PixelIndices.GetAllocatedSize());
-		}
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Palettes.GetAllocatedSize());
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetFramePixelsSize());
+		if (FrameCache.IsValid())
+			CumulativeResourceSize.AddDedicatedSystemMemoryBytes(FrameCache->GetFramePixelsSize());
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetCompressedFramesSize());
+		CumulativeResourceSize.AddDedicatedVideoMemoryBytes(CalcTextureMemorySizeEnum(TMC_ResidentMips));
 	}
 }
 
 
 
+bool UAnimatedTexture2D::UsesPreUploadedFrames() const
+{
+	const int32 NumFrame = Frames.Num();
+	if (NumFrame < 2)
+		return false;
+
+	switch (UploadMode)
+	{
+	case EAnimatedTextureUploadMode::Streaming:
+		return false;
+	case EAnimatedTextureUploadMode::PreUploadAllFrames:
+		return true;
+	default:
+	{
+		uint64 FrameBytes = HasCompressedFrames() ? GetCompressedFrameSize() : (uint64)GlobalWidth * GlobalHeight * sizeof(FColor);
+		uint64 TotalBytes = FrameBytes * NumFrame;
+		return NumFrame <= CVarAnimatedTexturePreUploadMaxFrames.GetValueOnAnyThread()
+			&& TotalBytes <= (uint64)CVarAnimatedTexturePreUploadMaxBytes.GetValueOnAnyThread();
+	}
+	}//end of switch
+}
+
+int32 UAnimatedTexture2D::GetTextureBufferCount() const
+{
+	return UsesPreUploadedFrames() ? 1 : FMath::Clamp(TextureBufferCount, 1, 3);
+}
+
 float UAnimatedTexture2D::GetAnimationLength() const
 {
 	return Duration;
@@ -172,36 +329,517 @@ UAnimatedTexture2D::UAnimatedTexture2D(const FObjectInitializer& ObjectInitializ
 
 }
 
+void UAnimatedTexture2D::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FAnimatedTextureCustomVersion::GUID);
+
+	if (Ar.IsSaving())
+		FinishAsyncParse();
+
+	// cooked packages carry the decoded frames, so the gif source is only needed to decode them again after the memory budget evicted them
+	bool bCookedFrames = Ar.IsSaving() && Ar.IsCooking() && bCookDecodedFrames && Frames.Num() > 0;
+	bool bHasGIFData = !bCookedFrames || bDecodeFramesOnDemand;
+#if WITH_EDITOR
+	if (bCookedFrames && !bHasGIFData)
+		bHasGIFData = FAnimatedTextureManager::HasMemoryBudget(Ar.CookingTarget());
+#endif // WITH_EDITOR
+
+	// composed frames replace the pixel indices and the GIF file, only the frame table is cooked with them.
+	// Platforms that can not sample BC1/BC3 keep the frames as chosen above
+#if WITH_EDITOR
+	bool bCompressedFrames = Ar.IsSaving() && Ar.IsCooking() && bCookCompressedFrames && BuildCompressedFrames(Ar.CookingTarget());
+#else
+	bool bCompressedFrames = false;
+#endif // WITH_EDITOR
+	if (bCompressedFrames)
+	{
+		bCookedFrames = true;
+		bHasGIFData = false;
+	}
+
+	Super::Serialize(Ar);
+
+	// older packages keep the GIF file in the RawData property, it is saved as bulk data from now on
+	if (Ar.IsLoading() && RawData.Num() > 0)
+	{
+		SetGIFData(RawData.GetData(), RawData.Num());
+		RawData.Empty();
+	}
+
+	if (Ar.CustomVer(FAnimatedTextureCustomVersion::GUID) < FAnimatedTextureCustomVersion::CookedFrameData)
+		return;
+
+	Ar << bCookedFrames;
+	if (bCookedFrames)
+	{
+		TArray<TArray<uint8>> StrippedPixels;
+		if (Ar.IsSaving() && bCompressedFrames)
+		{
+			for (FGIFFrame& Frame : Frames)
+				StrippedPixels.Add(MoveTemp(Frame.PixelIndices));
+		}
+
+		SerializeFrameData(Ar);
+
+		for (int32 i = 0; i < StrippedPixels.Num(); i++)
+			Frames[i].PixelIndices = MoveTemp(StrippedPixels[i]);
+	}
+
+	if (Ar.CustomVer(FAnimatedTextureCustomVersion::GUID) < FAnimatedTextureCustomVersion::GIFBulkData)
+		return;
+
+	Ar << bHasGIFData;
+	if (bHasGIFData)
+	{
+		Ar << GIFHeader;
+		SerializeGIFData(Ar);
+	}
+
+	if (Ar.CustomVer(FAnimatedTextureCustomVersion::GUID) < FAnimatedTextureCustomVersion::CompressedFrames)
+		return;
+
+	Ar << bCompressedFrames;
+	if (bCompressedFrames)
+		SerializeCompressedFrames(Ar);
+}
+
+void UAnimatedTexture2D::SerializeCompressedFrames(FArchive& Ar)
+{
+	if (Ar.IsLoading())
+	{
+		ResidentCompressedFrames.Reset();
+		ResidentCompressedFramesSize = 0;
+	}
+
+	Ar << CompressedFormat;
+	Ar << CompressedMipCount;
+
+#if WITH_EDITOR
+	// uploaded as they are while playing, so memory mapped when the platform allows
+	const uint32 CookFlags = BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload;
+	if (Ar.IsCooking())
+	{
+		CompressedFrameData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+		if (Ar.CookingTarget()->SupportsFeature(ETargetPlatformFeatures::MemoryMappedFiles))
+			CompressedFrameData.SetBulkDataFlags(BULKDATA_MemoryMappedPayload);
+	}
+#endif // WITH_EDITOR
+
+	CompressedFrameData.Serialize(Ar, this, INDEX_NONE, true);
+
+#if WITH_EDITOR
+	if (Ar.IsCooking())
+		CompressedFrameData.ClearBulkDataFlags(CookFlags);
+#endif // WITH_EDITOR
+}
+
+#if WITH_EDITOR
+// bump when the compositor, the mip filter or the block encoder changes its output
+#define ANIMATEDTEXTURE_COMPRESSED_FRAMES_DDC_VER TEXT("8E3F5A1C0B7D4C29A6E2D94F17B3C058")
+
+bool UAnimatedTexture2D::BuildCompressedFrames(const ITargetPlatform* TargetPlatform)
+{
+	const int32 NumFrame = Frames.Num();
+	if (NumFrame == 0)
+		return false;
+
+	// block compressed textures need whole blocks in their top mip
+	if (GlobalWidth % 4 != 0 || GlobalHeight % 4 != 0)
+	{
+		UE_LOG(LogAnimTexture, Warning, TEXT("%s is %ux%u, not a multiple of 4: its frames are cooked uncompressed"), *GetPathName(), GlobalWidth, GlobalHeight);
+		return false;
+	}
+
+	// the format is only known once the frames are composed, so the platform must take both
+	TArray<FName> TextureFormats;
+	TargetPlatform->GetAllTextureFormats(TextureFormats);
+	static const FName NameDXT1(TEXT("DXT1"));
+	static const FName NameDXT5(TEXT("DXT5"));
+	if (!TextureFormats.Contains(NameDXT1) || !TextureFormats.Contains(NameDXT5))
+	{
+		UE_LOG(LogAnimTexture, Log, TEXT("%s can not sample BC1/BC3 textures: %s is cooked uncompressed"), *TargetPlatform->PlatformName(), *GetPathName());
+		return false;
+	}
+
+	//-- the blocks only depend on the GIF file and the properties below
+	FString DDCKey;
+	const int64 GIFSize = GIFData.GetBulkDataSize();
+	if (GIFSize > 0)
+	{
+		FSHAHash GIFHash;
+		FSHA1::HashBuffer(GIFData.LockReadOnly(), GIFSize, GIFHash.Hash);
+		GIFData.Unlock();
+
+		const FString KeySuffix = FString::Printf(TEXT("%s_%d_%d"), *GIFHash.ToString(), SupportsTransparency ? 1 : 0, bGenerateMips ? 1 : 0);
+		DDCKey = FDerivedDataCacheInterface::BuildCacheKey(TEXT("ANIMTEX_BC"), ANIMATEDTEXTURE_COMPRESSED_FRAMES_DDC_VER, *KeySuffix);
+
+		TArray<uint8> CachedData;
+		if (GetDerivedDataCacheRef().GetSynchronous(*DDCKey, CachedData))
+		{
+			FMemoryReader Reader(CachedData);
+			Reader << CompressedFormat;
+			Reader << CompressedMipCount;
+
+			const int64 BlocksSize = Reader.TotalSize() - Reader.Tell();
+			CompressedFrameData.Lock(LOCK_READ_WRITE);
+			FMemory::Memcpy(CompressedFrameData.Realloc(BlocksSize), CachedData.GetData() + Reader.Tell(), BlocksSize);
+			CompressedFrameData.Unlock();
+			return true;
+		}
+	}
+
+	FAnimatedTextureCompositor Compositor(this, 0);
+
+	// BC1 only when no composed pixel is transparent, the background included
+	bool bTransparent = false;
+	if (SupportsTransparency)
+	{
+		Compositor.Reset();
+		for (int32 i = 0; i < NumFrame && !bTransparent; i++)
+		{
+			Compositor.ComposeFrame(i);
+			const FColor* Canvas = Compositor.GetCanvas();
+			for (uint32 p = 0, Count = GlobalWidth * GlobalHeight; p < Count && !bTransparent; p++)
+				bTransparent = Canvas[p].A < 255;
+			Compositor.DisposeFrame();
+		}// end of for
+	}
+	const EPixelFormat Format = bTransparent ? PF_DXT5 : PF_DXT1;
+
+	FAnimatedTextureMipChain MipChain;
+	MipChain.Init(GlobalWidth, GlobalHeight, bGenerateMips ? FAnimatedTextureMipChain::CalcNumMips(GlobalWidth, GlobalHeight) : 1);
+	const SIZE_T FrameSize = FAnimatedTextureMipChain::CalcTextureSize(GlobalWidth, GlobalHeight, MipChain.GetNumMips(), Format);
+
+	CompressedFrameData.Lock(LOCK_READ_WRITE);
+	uint8* const FirstBlock = (uint8*)CompressedFrameData.Realloc(FrameSize * NumFrame);
+	uint8* Blocks = FirstBlock;
+
+	//-- frames in playback order, each with its mips
+	Compositor.Reset();
+	for (int32 i = 0; i < NumFrame; i++)
+	{
+		// a frame that fails to decode keeps the canvas it would be drawn on
+		Compositor.ComposeFrame(i);
+		const FIntRect DirtyRect = Compositor.ConsumeDirtyRect();
+
+		EncodeBCImage(Compositor.GetCanvas(), GlobalWidth, GlobalHeight, Format, Blocks);
+		Blocks += GetBCImageSize(GlobalWidth, GlobalHeight, Format);
+
+		MipChain.Update(Compositor.GetCanvas(), DirtyRect);
+		for (int32 Mip = 1; Mip < MipChain.GetNumMips(); Mip++)
+		{
+			const uint32 MipWidth = MipChain.GetLevelWidth(Mip);
+			const uint32 MipHeight = MipChain.GetLevelHeight(Mip);
+			EncodeBCImage(MipChain.GetLevel(Mip), MipWidth, MipHeight, Format, Blocks);
+			Blocks += GetBCImageSize(MipWidth, MipHeight, Format);
+		}// end of for
+
+		Compositor.DisposeFrame();
+	}// end of for
+
+	CompressedFormat = Format;
+	CompressedMipCount = MipChain.GetNumMips();
+
+	if (!DDCKey.IsEmpty())
+	{
+		TArray<uint8> CachedData;
+		FMemoryWriter Writer(CachedData);
+		Writer << CompressedFormat;
+		Writer << CompressedMipCount;
+		Writer.Serialize(FirstBlock, FrameSize * NumFrame);
+		GetDerivedDataCacheRef().Put(*DDCKey, CachedData);
+	}
+
+	CompressedFrameData.Unlock();
+	return true;
+}
+#endif // WITH_EDITOR
+
+void UAnimatedTexture2D::SerializeGIFData(FArchive& Ar)
+{
+	if (Ar.IsLoading())
+		ReleaseGIFData();
+
+#if WITH_EDITOR
+	// cooked GIF files go to a file of their own, read when the texture parses them instead of with the package,
+	// and memory mapped when their frames are decoded on demand
+	const uint32 CookFlags = BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload;
+	if (Ar.IsCooking())
+	{
+		GIFData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+		if (bDecodeFramesOnDemand && Ar.CookingTarget()->SupportsFeature(ETargetPlatformFeatures::MemoryMappedFiles))
+			GIFData.SetBulkDataFlags(BULKDATA_MemoryMappedPayload);
+	}
+#endif // WITH_EDITOR
+
+	GIFData.Serialize(Ar, this, INDEX_NONE, bDecodeFramesOnDemand);
+
+#if WITH_EDITOR
+	if (Ar.IsCooking())
+		GIFData.ClearBulkDataFlags(CookFlags);
+#endif // WITH_EDITOR
+}
+
+void UAnimatedTexture2D::SerializeFrameData(FArchive& Ar)
+{
+	Ar << GlobalWidth;
+	Ar << GlobalHeight;
+	Ar << Background;
+	Ar << Duration;
+
+	if (Ar.IsLoading() && Ar.CustomVer(FAnimatedTextureCustomVersion::GUID) < FAnimatedTextureCustomVersion::SharedPalettes)
+	{
+		SerializeLegacyFrames(Ar, Frames, Palettes);
+	}
+	else
+	{
+		Ar << Frames;
+		Ar << Palettes;
+	}
+
+	if (Ar.IsLoading())
+	{
+		FrameNum = Frames.Num();
+		BuildFrameStartTimes();
+		CreateFrameCache();
+	}
+}
+
 void UAnimatedTexture2D::PostLoad()
 {
-	ParseRawData();
+	// the resource uploads the composed frames as they are, they are usually memory mapped
+	if (CompressedFrameData.GetBulkDataSize() > 0)
+	{
+		AcquireBulkData(CompressedFrameData, ResidentCompressedFrames, ResidentCompressedFramesSize);
+		if (ResidentCompressedFramesSize != (int64)GetCompressedFrameSize() * Frames.Num())
+		{
+			UE_LOG(LogAnimTexture, Warning, TEXT("%s: compressed frames do not match the frame table, the texture only shows its background"), *GetPathName());
+			ResidentCompressedFrames.Reset();
+			ResidentCompressedFramesSize = 0;
+		}
+	}
+
+	// frames were deserialized from a cooked package
+	if (Frames.Num() == 0)
+	{
+		if (CVarAnimatedTextureAsyncParse.GetValueOnGameThread() != 0 && ReadGIFHeader())
+			ParseGIFDataAsync();
+		else
+			ParseGIFData();
+	}
+	else if (KeepsGIFData())
+	{
+		// cooked frames decoded on demand read the file while playing, it is usually memory mapped
+		AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+	}
 	Super::PostLoad();
 }
 
 void UAnimatedTexture2D::BeginDestroy() 
 {
+	FinishAsyncParse();
 	Super::BeginDestroy();
 }
 
 
 bool UAnimatedTexture2D::ImportGIF(const uint8* Buffer, uint32 BufferSize)
 {
+	FinishAsyncParse();
+	TArray<UAnimatedTexturePlayer*> ReleasedPlayers = ReleasePlayerResources();
+
 	Frames.Empty();
-	RawData.SetNumUninitialized(BufferSize);
-	FMemory::Memcpy(RawData.GetData(), Buffer, BufferSize);
+	SetGIFData(Buffer, BufferSize);
+
+	// parsed from the caller's buffer, GIFData holds the only copy
+	FGIFParseResult Result;
+	bool bSucceeded = bDecodeFramesOnDemand ?
+		ScanGIFBinary(Result, Buffer, BufferSize) :
+		LoadGIFBinary(Result, Buffer, BufferSize);
+	ApplyParseResult(Result);
+
+	if (KeepsGIFData())
+		AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+
+	RecreatePlayerResources(ReleasedPlayers);
+	return bSucceeded;
+}
+
+TSharedPtr<FGIFParseResult> UAnimatedTexture2D::ParseGIF(const uint8* Buffer, uint32 BufferSize)
+{
+	TSharedPtr<FGIFParseResult> Parsed = MakeShared<FGIFParseResult>();
+	if (!LoadGIFBinary(*Parsed, Buffer, BufferSize) || Parsed->Frames.Num() == 0)
+		return nullptr;
+	return Parsed;
+}
+
+void UAnimatedTexture2D::ImportParsedGIF(const uint8* Buffer, uint32 BufferSize, const TSharedRef<FGIFParseResult>& Parsed)
+{
+	FinishAsyncParse();
+	TArray<UAnimatedTexturePlayer*> ReleasedPlayers = ReleasePlayerResources();
+
+	SetGIFData(Buffer, BufferSize);
+	ApplyParseResult(*Parsed);
+
+	// decoded frames were only needed to find out the file is valid, frames without offset can not be decoded again
+	if (bDecodeFramesOnDemand)
+	{
+		for (FGIFFrame& Frame : Frames)
+		{
+			if (Frame.DataOffset > 0)
+				Frame.PixelIndices.Empty();
+		}// end of for
+	}
+
+	if (KeepsGIFData())
+		AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+
+	RecreatePlayerResources(ReleasedPlayers);
+}
+
+void UAnimatedTexture2D::SetGIFData(const uint8* Buffer, uint32 BufferSize)
+{
+	ReleaseGIFData();
+
+	GIFData.Lock(LOCK_READ_WRITE);
+	void* Data = GIFData.Realloc(BufferSize);
+	if (BufferSize > 0)
+		FMemory::Memcpy(Data, Buffer, BufferSize);
+	GIFData.Unlock();
+
+	// logical screen descriptor, then the global palette if there is one
+	uint32 HeaderSize = 13;
+	if (BufferSize > 10 && (Buffer[10] & 0x80))
+		HeaderSize += 3 * (2 << (Buffer[10] & 7));
+	HeaderSize = FMath::Min(HeaderSize, BufferSize);
+
+	GIFHeader.SetNumUninitialized(HeaderSize);
+	if (HeaderSize > 0)
+		FMemory::Memcpy(GIFHeader.GetData(), Buffer, HeaderSize);
+}
+
+void UAnimatedTexture2D::AcquireBulkData(FByteBulkData& BulkData, TUniquePtr<FOwnedBulkDataPtr>& OutResident, int32& OutResidentSize)
+{
+	if (OutResident.IsValid() || BulkData.GetBulkDataSize() == 0)
+		return;
+
+	OutResidentSize = (int32)BulkData.GetBulkDataSize();
+	if (GIsEditor)
+	{
+		// the editor saves the bulk data again, so it keeps its own copy
+		void* Copy = nullptr;
+		BulkData.GetCopy(&Copy, false);
+		OutResident = MakeUnique<FOwnedBulkDataPtr>(Copy);
+	}
+	else
+	{
+		// takes the memory mapping or the loaded copy, the bulk data can load again from disk
+		OutResident.Reset(BulkData.StealFileMapping());
+	}
+}
+
+bool UAnimatedTexture2D::KeepsGIFData() const
+{
+	// fully decoded frames load it again if the memory budget evicts their pixels, see AllowFramePixelsEviction
+	return bDecodeFramesOnDemand;
+}
 
-	return ParseRawData();
+void UAnimatedTexture2D::ReleaseGIFData()
+{
+	ResidentGIF.Reset();
+	ResidentGIFSize = 0;
+}
+
+SIZE_T UAnimatedTexture2D::GetGIFDataSize() const
+{
+	SIZE_T Size = ResidentGIF.IsValid() ? ResidentGIFSize : 0;
+	if (GIFData.IsBulkDataLoaded())
+		Size += GIFData.GetBulkDataSize();
+	return Size;
+}
+
+const uint8* UAnimatedTexture2D::GetCompressedFrame(int32 FrameIndex) const
+{
+	check(HasCompressedFrames());
+	return (const uint8*)ResidentCompressedFrames->GetPointer() + (SIZE_T)GetCompressedFrameSize() * FrameIndex;
+}
+
+uint32 UAnimatedTexture2D::GetCompressedFrameSize() const
+{
+	return (uint32)FAnimatedTextureMipChain::CalcTextureSize(GlobalWidth, GlobalHeight, CompressedMipCount, GetCompressedFormat());
+}
+
+const uint8* UAnimatedTexture2D::GetFramePixels(const FGIFFrame& Frame, TArray<uint8>& Scratch) const
+{
+	if (Frame.PixelIndices.Num() > 0)
+		return Frame.PixelIndices.GetData();
+
+	return DecodeGIFFrame(GetResidentGIF(), ResidentGIFSize, Frame, Scratch);
+}
+
+SIZE_T UAnimatedTexture2D::GetFramePixelsSize() const
+{
+	SIZE_T Size = 0;
+	for (const FGIFFrame& Frame : Frames)
+		Size += Frame.PixelIndices.GetAllocatedSize();
+	return Size;
+}
+
+void UAnimatedTexture2D::AllowFramePixelsEviction()
+{
+	check(IsInGameThread());
+
+	// the editor may still save the frames, a cook for a platform without a budget strips the GIF file
+	if (GIsEditor || AsyncParseTask || !FrameCache.IsValid() || FrameCache->GetFramePixelsSize() == 0)
+		return;
+
+	AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+	if (!ResidentGIF.IsValid())
+		return;
+
+	// fully decoded frames do not know where their data is, the render thread only reads it once their pixels are gone
+	bool bHasOffsets = true;
+	for (const FGIFFrame& Frame : Frames)
+		bHasOffsets &= Frame.DataOffset > 0;
+
+	if (!bHasOffsets)
+	{
+		FGIFParseResult Scan;
+		if (!ScanGIFBinary(Scan, GetResidentGIF(), ResidentGIFSize) || Scan.Frames.Num() != Frames.Num())
+			return;
+		for (int32 i = 0; i < Frames.Num(); i++)
+			Frames[i].DataOffset = Scan.Frames[i].DataOffset;
+	}
+
+	FAnimatedTextureFrameCachePtr EvictableFrameCache = FrameCache;
+	ENQUEUE_RENDER_COMMAND(AnimatedTextureAllowEviction)(
+		[EvictableFrameCache](FRHICommandListImmediate& RHICmdList)
+		{
+			EvictableFrameCache->bCanEvictFramePixels = true;
+		});
 }
 
-void UAnimatedTexture2D::Import_Init(uint32 InGlobalWidth, uint32 InGlobalHeight, uint8 InBackground, uint32 InFrameCount)
+FColor UAnimatedTexture2D::GetBackgroundColor() const
 {
-	GlobalWidth = InGlobalWidth;
-	GlobalHeight = InGlobalHeight;
-	Background = InBackground;
+	if (SupportsTransparency)
+		return FColor(0L);
 
+	if (Frames.Num() > 0)
+	{
+		FColor BGColor = GetPalette(Frames[0])[Background];
+		BGColor.A = 255;
+		return BGColor;
+	}
 
-	Frames.SetNum(InFrameCount);
-	FrameNum = InFrameCount;
+	// global palette follows the 13 bytes logical screen descriptor
+	const uint32 PaletteOffset = 13;
+	if (GIFHeader.Num() > (int32)PaletteOffset && (GIFHeader[10] & 0x80))
+	{
+		const uint32 PaletteSize = 2 << (GIFHeader[10] & 7);
+		const uint32 ColorOffset = PaletteOffset + 3 * Background;
+		if (Background < PaletteSize && ColorOffset + 3 <= (uint32)GIFHeader.Num())
+			return FColor(GIFHeader[ColorOffset], GIFHeader[ColorOffset + 1], GIFHeader[ColorOffset + 2]);
+	}
+	return FColor::Black;
 }
 
 void UAnimatedTexture2D::Import_Finished()
@@ -209,6 +847,64 @@ void UAnimatedTexture2D::Import_Finished()
 	Duration = 0.0f;
 	for (const auto& Frm : Frames)
 		Duration += Frm.Time;
+
+	BuildFrameStartTimes();
+	CreateFrameCache();
+}
+
+void UAnimatedTexture2D::CreateFrameCache()
+{
+	FrameCache = MakeShared<FAnimatedTextureFrameCache, ESPMode::ThreadSafe>();
+
+	// the editor saves the frames, elsewhere the render thread owns their pixels so the memory budget can free them
+	if (GIsEditor)
+		return;
+
+	TArray<TArray<uint8>> FramePixels;
+	FramePixels.SetNum(Frames.Num());
+	for (int32 i = 0; i < Frames.Num(); i++)
+		FramePixels[i] = MoveTemp(Frames[i].PixelIndices);
+	FrameCache->SetFramePixels(MoveTemp(FramePixels));
+}
+
+void UAnimatedTexture2D::BuildFrameStartTimes()
+{
+	FrameStartTimes.SetNumUninitialized(Frames.Num() + 1);
+
+	float StartTime = 0.0f;
+	for (int32 i = 0; i < Frames.Num(); i++)
+	{
+		FrameStartTimes[i] = StartTime;
+		StartTime += Frames[i].Time > 0.0f ? Frames[i].Time : DefaultFrameDelay;
+	}// end of for
+	FrameStartTimes[Frames.Num()] = StartTime;
+}
+
+int32 UAnimatedTexture2D::FindFrameAtTime(float Time, float& OutFrameTime) const
+{
+	const int32 NumFrame = Frames.Num();
+	check(NumFrame > 0 && FrameStartTimes.Num() == NumFrame + 1);
+
+	// last frame starting at or before Time
+	int32 FrameIndex = Algo::UpperBound(TArrayView<const float>(FrameStartTimes.GetData(), NumFrame), Time) - 1;
+	FrameIndex = FMath::Clamp(FrameIndex, 0, NumFrame - 1);
+
+	OutFrameTime = Time - FrameStartTimes[FrameIndex];
+	return FrameIndex;
+}
+
+int32 UAnimatedTexture2D::FindPlaybackFrame(float Time, bool bInLooping, float& OutFrameTime) const
+{
+	float Length = GetPlaybackLength();
+	Time = FMath::Max(Time, 0.0f);
+	if (Length <= 0.0f)
+		Time = 0.0f;
+	else if (bInLooping)
+		Time = FMath::Fmod(Time, Length);
+	else
+		Time = FMath::Min(Time, Length);
+
+	return FindFrameAtTime(Time, OutFrameTime);
 }
 
 void UAnimatedTexture2D::PostInitProperties()
@@ -216,29 +912,228 @@ void UAnimatedTexture2D::PostInitProperties()
 	Super::PostInitProperties();
 }
 
-bool UAnimatedTexture2D::ParseRawData()
+bool UAnimatedTexture2D::ReadGIFHeader()
 {
-	int Ret = GIF_Load((void*)RawData.GetData(), RawData.Num(), GIFFrameLoader1, 0, (void*)this, 0L);
-	this->Import_Finished();
-
-	if (Ret < 0) {
-		UE_LOG(LogTexture, Warning, TEXT("gif format error."));
+	// logical screen descriptor: signature, width, height, flags, background, aspect
+	if (GIFHeader.Num() < 13 || !isGifData(GIFHeader.GetData()))
 		return false;
+
+	GlobalWidth = GIFHeader[6] | (GIFHeader[7] << 8);
+	GlobalHeight = GIFHeader[8] | (GIFHeader[9] << 8);
+	Background = GIFHeader[11];
+	return GlobalWidth > 0 && GlobalHeight > 0;
+}
+
+bool UAnimatedTexture2D::ParseGIFData()
+{
+	TArray<UAnimatedTexturePlayer*> ReleasedPlayers = ReleasePlayerResources();
+
+	AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+	const uint8* Buffer = GetResidentGIF();
+
+	FGIFParseResult Result;
+	bool bSucceeded = Buffer != nullptr && (bDecodeFramesOnDemand ?
+		ScanGIFBinary(Result, Buffer, ResidentGIFSize) :
+		LoadGIFBinary(Result, Buffer, ResidentGIFSize));
+	ApplyParseResult(Result);
+
+	if (!KeepsGIFData())
+		ReleaseGIFData();
+
+	RecreatePlayerResources(ReleasedPlayers);
+	return bSucceeded;
+}
+
+void UAnimatedTexture2D::ParseGIFDataAsync()
+{
+	check(AsyncParseTask == nullptr);
+
+	// uncooked bulk data may read through the package loader, which only the game thread can use
+	if (!FPlatformProperties::RequiresCookedData())
+		AcquireBulkData(GIFData, ResidentGIF, ResidentGIFSize);
+
+	AsyncParseTask = new FAsyncTask<FGIFParseTask>(this, GIFData, ResidentGIF, ResidentGIFSize, bDecodeFramesOnDemand, KeepsGIFData());
+	AsyncParseTask->StartBackgroundTask();
+}
+
+void UAnimatedTexture2D::FinishAsyncParse()
+{
+	if (AsyncParseTask == nullptr)
+		return;
+
+	// blocks only if the task is still running, e.g. when saved or destroyed mid-parse
+	AsyncParseTask->EnsureCompletion();
+	FGIFParseTask& Task = AsyncParseTask->GetTask();
+	ApplyParseResult(Task.Result);
+
+	delete AsyncParseTask;
+	AsyncParseTask = nullptr;
+
+	if (Frames.Num() == 0)
+		return;
+
+	// resources, the players' too, only show the background until they are told the frames are in place
+	TArray<FAnimatedTextureResource*> WaitingResources;
+	if (Resource)
+		WaitingResources.Add(static_cast<FAnimatedTextureResource*>(Resource));
+	for (const TWeakObjectPtr<UAnimatedTexturePlayer>& WeakPlayer : Players)
+	{
+		UAnimatedTexturePlayer* Player = WeakPlayer.Get();
+		if (Player && Player->Source == this && Player->Resource)
+			WaitingResources.Add(static_cast<FAnimatedTextureResource*>(Player->Resource));
+	}// end of for
+
+	if (WaitingResources.Num() > 0)
+	{
+		FAnimatedTextureFrameCachePtr NewFrameCache = FrameCache;
+		ENQUEUE_RENDER_COMMAND(AnimatedTextureFramesReady)(
+			[WaitingResources, NewFrameCache](FRHICommandListImmediate& RHICmdList)
+			{
+				for (FAnimatedTextureResource* AnimResource : WaitingResources)
+					AnimResource->OnFramesReady(NewFrameCache);
+			});
 	}
-	return true;
+}
+
+void UAnimatedTexture2D::RegisterPlayer(UAnimatedTexturePlayer* Player)
+{
+	Players.RemoveAllSwap([](const TWeakObjectPtr<UAnimatedTexturePlayer>& WeakPlayer) { return !WeakPlayer.IsValid(); });
+	Players.AddUnique(Player);
+}
+
+TArray<UAnimatedTexturePlayer*> UAnimatedTexture2D::ReleasePlayerResources()
+{
+	TArray<UAnimatedTexturePlayer*> ReleasedPlayers;
+	for (const TWeakObjectPtr<UAnimatedTexturePlayer>& WeakPlayer : Players)
+	{
+		// players switched to another source keep their resource
+		UAnimatedTexturePlayer* Player = WeakPlayer.Get();
+		if (Player && Player->Source == this && Player->Resource)
+		{
+			Player->ReleaseResource();
+			ReleasedPlayers.Add(Player);
+		}
+	}// end of for
+
+	// the render thread may still be composing from the old frames
+	if (ReleasedPlayers.Num() > 0)
+		FlushRenderingCommands();
+	return ReleasedPlayers;
+}
+
+void UAnimatedTexture2D::RecreatePlayerResources(const TArray<UAnimatedTexturePlayer*>& ReleasedPlayers)
+{
+	// new resources pick up the frame count, frame cache and sizes of the new frames
+	for (UAnimatedTexturePlayer* Player : ReleasedPlayers)
+		Player->UpdateResource();
+}
+
+void UAnimatedTexture2D::ApplyParseResult(FGIFParseResult& Result)
+{
+	GlobalWidth = Result.GlobalWidth;
+	GlobalHeight = Result.GlobalHeight;
+	Background = Result.Background;
+	Frames = MoveTemp(Result.Frames);
+	Palettes = MoveTemp(Result.Palettes);
+	FrameNum = Frames.Num();
+
+	Import_Finished();
 }
 
 void UAnimatedTexture2D::Play()
 {
 	bPlaying = true;
+	UpdatePlaybackSettings();
 }
 
 void UAnimatedTexture2D::PlayFromStart()
 {
 	bPlaying = true;
+	UpdatePlaybackSettings();
+	SeekToFrame(0);
+}
+
+void UAnimatedTexture2D::SeekToFrame(int32 FrameIndex)
+{
+	SeekInternal(FrameIndex, 0.0f);
+}
+
+void UAnimatedTexture2D::SeekToTime(float Time)
+{
+	if (Frames.Num() == 0)
+		return;
+
+	float FrameTime = 0.0f;
+	int32 FrameIndex = FindPlaybackFrame(Time, bLooping, FrameTime);
+	SeekInternal(FrameIndex, FrameTime);
+}
+
+void UAnimatedTexture2D::SeekInternal(int32 FrameIndex, float FrameTime)
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	ENQUEUE_RENDER_COMMAND(AnimatedTextureSeek)(
+		[AnimResource, FrameIndex, FrameTime](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SeekToFrame(FrameIndex, FrameTime);
+		});
 }
 
 void UAnimatedTexture2D::Stop()
 {
 	bPlaying = false;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexture2D::SetLooping(bool bNewLooping)
+{
+	bLooping = bNewLooping;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexture2D::SetPlayRate(float NewRate)
+{
+	PlayRate = NewRate;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexture2D::SetAlwaysTickEvenNoSee(bool bNewAlwaysTick)
+{
+	bAlwaysTickEvenNoSee = bNewAlwaysTick;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexture2D::SetMaxUpdateRate(float NewMaxUpdateRate)
+{
+	MaxUpdateRate = FMath::Max(NewMaxUpdateRate, 0.0f);
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexture2D::ReportScreenSize(float ScreenSize)
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	ENQUEUE_RENDER_COMMAND(AnimatedTextureScreenSize)(
+		[AnimResource, ScreenSize](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SetScreenSize(ScreenSize);
+		});
+}
+
+void UAnimatedTexture2D::UpdatePlaybackSettings()
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	FAnimatedTexturePlaybackSettings Settings(PlayRate, MaxUpdateRate, IsPlaying(), bLooping, bAlwaysTickEvenNoSee);
+	ENQUEUE_RENDER_COMMAND(AnimatedTexturePlayback)(
+		[AnimResource, Settings](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SetPlaybackSettings(Settings);
+		});
 }
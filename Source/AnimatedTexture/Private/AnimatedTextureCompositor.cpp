@@ -0,0 +1,469 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTextureCompositor.h"
+#include "AnimatedTexture2D.h"
+#include "AnimatedTextureModule.h"
+#include "AnimatedTextureKernels.h"
+#include "AnimatedTextureMipChain.h"
+#include "AnimatedTextureStats.h"
+
+#include "HAL/IConsoleManager.h"	// Core
+#include "Async/ParallelFor.h"	// Core
+#include "Async/TaskGraphInterfaces.h"	// Core
+
+#include "gif_load/gif_load.h" // from: https://github.com/hidefromkgb/gif_load
+
+static TAutoConsoleVariable<int32> CVarAnimatedTextureParallelCompositePixels(
+	TEXT("r.AnimatedTexture.ParallelCompositePixels"),
+	512 * 512,
+	TEXT("Frames and disposal areas of at least this many pixels are split in row bands drawn on worker threads,\n")
+	TEXT("smaller ones stay on the calling thread. 0 never splits."),
+	ECVF_Default);
+
+/** Run Body over [MinY, MaxY) in row bands, in parallel when the area is large enough */
+static void ForEachRowBand(int32 MinY, int32 MaxY, int32 RowPixels, TFunctionRef<void(int32, int32)> Body)
+{
+	const int32 NumRows = MaxY - MinY;
+	if (NumRows <= 0 || RowPixels <= 0)
+		return;
+
+	const int32 MinPixels = CVarAnimatedTextureParallelCompositePixels.GetValueOnAnyThread();
+	const int32 NumWorkers = FTaskGraphInterface::IsRunning() ? FTaskGraphInterface::Get().GetNumWorkerThreads() : 0;
+	if (MinPixels <= 0 || NumWorkers == 0 || NumRows < 2 || (int64)NumRows * RowPixels < MinPixels)
+	{
+		Body(MinY, MaxY);
+		return;
+	}
+
+	// the calling thread takes a band too
+	const int32 NumBands = FMath::Min(NumRows, NumWorkers + 1);
+	const int32 BandRows = FMath::DivideAndRoundUp(NumRows, NumBands);
+	ParallelFor(NumBands, [MinY, MaxY, BandRows, &Body](int32 Band)
+	{
+		int32 BandMinY = MinY + Band * BandRows;
+		int32 BandMaxY = FMath::Min(BandMinY + BandRows, MaxY);
+		if (BandMinY < BandMaxY)
+			Body(BandMinY, BandMaxY);
+	});
+}
+
+static void FillRect(FColor* Canvas, uint32 CanvasWidth, const FIntRect& Rect, FColor Color)
+{
+	ForEachRowBand(Rect.Min.Y, Rect.Max.Y, Rect.Width(), [Canvas, CanvasWidth, &Rect, Color](int32 MinY, int32 MaxY)
+	{
+		for (int32 Y = MinY; Y < MaxY; Y++)
+			FillColor(Canvas + CanvasWidth * Y + Rect.Min.X, Rect.Width(), Color);
+	});
+}
+
+static void CopyRect(FColor* Dest, const FColor* Src, uint32 CanvasWidth, const FIntRect& Rect)
+{
+	ForEachRowBand(Rect.Min.Y, Rect.Max.Y, Rect.Width(), [Dest, Src, CanvasWidth, &Rect](int32 MinY, int32 MaxY)
+	{
+		for (int32 Y = MinY; Y < MaxY; Y++)
+		{
+			uint32 RowStart = CanvasWidth * Y + Rect.Min.X;
+			FMemory::Memcpy(Dest + RowStart, Src + RowStart, Rect.Width() * sizeof(FColor));
+		}// end of for(y)
+	});
+}
+
+/** ExpandPaletteIndices of every Stride-th index, for canvases smaller than the GIF */
+static void ExpandPaletteIndicesStrided(FColor* Dest, const uint8* Indices, uint32 Count, uint32 Stride, const FColor* Palette, int32 TransparentIndex)
+{
+	for (uint32 i = 0; i < Count; i++)
+	{
+		const uint8 Index = Indices[i * Stride];
+		if (Index != TransparentIndex)
+			Dest[i] = Palette[Index];
+	}// end of for
+}
+
+/**
+ * Position of a frame row in the pixel data, interlaced frames store rows 0,8,16.. then 4,12.. then 2,6.. then 1,3..
+ * see: https://en.wikipedia.org/wiki/GIF#Interlacing
+ */
+static uint32 GetInterlacedRow(uint32 Y, uint32 FrameHeight)
+{
+	const uint32 Pass1Rows = (FrameHeight + 7) / 8;
+	const uint32 Pass2Rows = (FrameHeight + 3) / 8;
+	const uint32 Pass3Rows = (FrameHeight + 1) / 4;
+
+	if ((Y & 7) == 0)
+		return Y / 8;
+	if ((Y & 7) == 4)
+		return Pass1Rows + Y / 8;
+	if ((Y & 3) == 2)
+		return Pass1Rows + Pass2Rows + Y / 4;
+	return Pass1Rows + Pass2Rows + Pass3Rows + Y / 2;
+}
+
+FAnimatedTextureCompositor::FAnimatedTextureCompositor(const UAnimatedTexture2D* InOwner, int32 InKeyframeInterval)
+	:Owner(InOwner),
+	Width(0),
+	Height(0),
+	Scale(0),
+	NextFrame(0),
+	bCanonical(true),
+	LastFrame(INDEX_NONE),
+	KeyframeInterval(FMath::Max(InKeyframeInterval, 0))
+{
+}
+
+SIZE_T FAnimatedTextureFrameCache::GetFrameTexturesSize() const
+{
+	SIZE_T Size = 0;
+	for (const FTexture2DRHIRef& FrameTexture : FrameTextures)
+		Size += FAnimatedTextureMipChain::CalcTextureSize(FrameTexture->GetSizeX(), FrameTexture->GetSizeY(), FrameTexture->GetNumMips(), FrameTexture->GetFormat());
+	return Size;
+}
+
+SIZE_T FAnimatedTextureFrameCache::GetAllocatedSize() const
+{
+	SIZE_T Size = Keyframes.GetAllocatedSize() + FrameTextures.GetAllocatedSize();
+	for (const TArray<FColor>& Keyframe : Keyframes)
+		Size += Keyframe.GetAllocatedSize();
+	return Size;
+}
+
+SIZE_T FAnimatedTextureFrameCache::EvictKeyframes()
+{
+	SIZE_T Size = 0;
+	for (const TArray<FColor>& Keyframe : Keyframes)
+		Size += Keyframe.GetAllocatedSize();
+
+	Keyframes.Empty();
+	return Size;
+}
+
+void FAnimatedTextureFrameCache::SetFramePixels(TArray<TArray<uint8>>&& InFramePixels)
+{
+	FramePixels = MoveTemp(InFramePixels);
+
+	uint64 Size = FramePixels.GetAllocatedSize();
+	for (const TArray<uint8>& Pixels : FramePixels)
+		Size += Pixels.GetAllocatedSize();
+	FramePixelsSize = Size;
+}
+
+SIZE_T FAnimatedTextureFrameCache::EvictFramePixels()
+{
+	check(IsInRenderingThread());
+
+	if (!bCanEvictFramePixels)
+		return 0;
+
+	SIZE_T Size = GetFramePixelsSize();
+	FramePixels.Empty();
+	FramePixelsSize = 0;
+	return Size;
+}
+
+void FAnimatedTextureCompositor::SetFrameCache(const FAnimatedTextureFrameCachePtr& InFrameCache)
+{
+	FrameCache = InFrameCache;
+}
+
+void FAnimatedTextureCompositor::SetScale(int32 InScale)
+{
+	InScale = FMath::Clamp(InScale, 0, MaxScale);
+	if (InScale == Scale)
+		return;
+
+	Scale = InScale;
+	Empty();
+}
+
+void FAnimatedTextureCompositor::InitCanvasSize()
+{
+	Width = GetScaledSize(Owner->GlobalWidth, Scale);
+	Height = GetScaledSize(Owner->GlobalHeight, Scale);
+
+	// Empty() drops the restore buffer, GIF_PREV frames save into it whatever the canvas starts from
+	Restore.SetNumUninitialized(Width * Height);
+}
+
+void FAnimatedTextureCompositor::Reset()
+{
+	InitCanvasSize();
+
+	FColor BGColor = Owner->GetBackgroundColor();
+	Canvas.Init(BGColor, Width * Height);
+
+	// players of one texture may ask for different intervals, the first one to capture wins
+	if (KeyframeInterval > 0 && FrameCache.IsValid() && FrameCache->Keyframes.Num() == 0)
+	{
+		FrameCache->KeyframeInterval = KeyframeInterval;
+		FrameCache->KeyframeScale = Scale;
+		FrameCache->Keyframes.SetNum(FMath::DivideAndRoundUp(Owner->GetFrameCount(), KeyframeInterval));
+	}
+
+	NextFrame = 0;
+	bCanonical = true;
+	LastFrame = INDEX_NONE;
+	MarkAllDirty();
+}
+
+void FAnimatedTextureCompositor::Empty()
+{
+	Canvas.Empty();
+	Restore.Empty();
+	ScratchIndices.Empty();
+
+	NextFrame = 0;
+	LastFrame = INDEX_NONE;
+	DirtyRect = FIntRect();
+}
+
+void FAnimatedTextureCompositor::MarkAllDirty()
+{
+	DirtyRect = FIntRect(0, 0, Width, Height);
+}
+
+bool FAnimatedTextureCompositor::ComposeFrame(int32 FrameIndex)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexComposite);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Composite);
+
+	if (!IsInitialized())
+		Reset();
+
+	// pixels handed over to the cache, else the texture's own or decoded from its GIF file
+	const FGIFFrame& GIFFrame = Owner->Frames[FrameIndex];
+	const uint8* PixelIndices = FrameCache.IsValid() ? FrameCache->GetFramePixels(FrameIndex) : nullptr;
+	if (!PixelIndices)
+		PixelIndices = Owner->GetFramePixels(GIFFrame, ScratchIndices);
+	if (!PixelIndices)
+	{
+		UE_LOG(LogAnimTexture, Warning, TEXT("Unable to decode frame %d of %s"), FrameIndex, *Owner->GetName());
+		LastFrame = INDEX_NONE;
+		return false;
+	}
+
+	// after a loop wrapped around the canvas no longer matches a replay from frame 0
+	if (FrameIndex != NextFrame)
+		bCanonical = false;
+	if (bCanonical && FrameIndex > 0)
+		CaptureKeyframe();
+
+	FColor* PICT = Canvas.GetData();
+	const FColor* Pal = Owner->GetPalette(GIFFrame);
+
+	// frames may exceed the global bounds in some GIFs
+	FIntRect FrameRect(GIFFrame.OffsetX, GIFFrame.OffsetY, GIFFrame.OffsetX + GIFFrame.Width, GIFFrame.OffsetY + GIFFrame.Height);
+	FrameRect.Clip(FIntRect(0, 0, Owner->GlobalWidth, Owner->GlobalHeight));
+	FrameRect = ToCanvasRect(FrameRect);
+
+	//-- save the area this frame covers, GIF_PREV restores it after the frame is shown
+	if (GIFFrame.Mode == GIF_PREV && FrameIndex != 0)
+		CopyRect(Restore.GetData(), PICT, Width, FrameRect);
+
+	//-- decode to frame buffer, row bands of large frames in parallel
+	const uint32 CanvasWidth = Width;
+	const int32 Shift = Scale;
+	ForEachRowBand(FrameRect.Min.Y, FrameRect.Max.Y, FrameRect.Width(), [&GIFFrame, &FrameRect, PICT, CanvasWidth, Shift, PixelIndices, Pal](int32 MinY, int32 MaxY)
+	{
+		const uint32 VisibleWidth = FrameRect.Width();
+		const uint32 FirstColumn = (FrameRect.Min.X << Shift) - GIFFrame.OffsetX;
+		for (int32 DestY = MinY; DestY < MaxY; DestY++)
+		{
+			uint32 Y = (DestY << Shift) - GIFFrame.OffsetY;
+			uint32 SrcRow = GIFFrame.Interlacing ? GetInterlacedRow(Y, GIFFrame.Height) : Y;
+
+			FColor* DestRow = PICT + CanvasWidth * DestY + FrameRect.Min.X;
+			const uint8* SrcIndices = PixelIndices + SrcRow * GIFFrame.Width + FirstColumn;
+			if (Shift == 0)
+				ExpandPaletteIndices(DestRow, SrcIndices, VisibleWidth, Pal, GIFFrame.TransparentIndex);
+			else
+				ExpandPaletteIndicesStrided(DestRow, SrcIndices, VisibleWidth, 1u << Shift, Pal, GIFFrame.TransparentIndex);
+		}// end of for(y)
+	});
+
+	AddDirtyRect(FrameRect);
+
+	LastFrame = FrameIndex;
+	LastFrameRect = FrameRect;
+	NextFrame = FrameIndex + 1;
+	return true;
+}
+
+void FAnimatedTextureCompositor::DisposeFrame()
+{
+	if (LastFrame == INDEX_NONE)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexDispose);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Dispose);
+
+	const FGIFFrame& GIFFrame = Owner->Frames[LastFrame];
+	bool FirstFrame = LastFrame == 0;
+	LastFrame = INDEX_NONE;
+
+	FColor* PICT = Canvas.GetData();
+	const FColor* Pal = Owner->GetPalette(GIFFrame);
+	uint32 InBackground = Owner->Background;
+
+	//-- frame blending
+	EGIF_Mode Mode = (EGIF_Mode)GIFFrame.Mode;
+
+	if (Mode == GIF_PREV && FirstFrame)	// loop restart
+		Mode = GIF_BKGD;
+
+	switch (Mode)
+	{
+	case GIF_NONE:
+	case GIF_CURR:
+		break;
+	case GIF_BKGD:	// restore background
+	{
+		FColor BGColor(0L);
+
+		if (Owner->SupportsTransparency)
+		{
+			if (GIFFrame.TransparentIndex == -1)
+				BGColor = Pal[InBackground];
+			else
+				BGColor = Pal[GIFFrame.TransparentIndex];
+			BGColor.A = 0;
+		}
+		else
+		{
+			BGColor = Pal[InBackground];
+			BGColor.A = 255;
+		}
+
+		FIntRect BGRect = FirstFrame ? FIntRect(0, 0, Width, Height) : LastFrameRect;
+		FillRect(PICT, Width, BGRect, BGColor);
+		AddDirtyRect(BGRect);
+	}
+	break;
+	case GIF_PREV:	// restore prevous frame
+		CopyRect(PICT, Restore.GetData(), Width, LastFrameRect);
+		AddDirtyRect(LastFrameRect);
+		break;
+	default:
+		UE_LOG(LogAnimTexture, Warning, TEXT("Unknown GIF Mode"));
+		break;
+	}//end of switch
+}
+
+void FAnimatedTextureCompositor::SeekTo(int32 FrameIndex)
+{
+	DisposeFrame();
+
+	// frame 0 is a plain reset
+	int32 Start = FindKeyframe(FrameIndex);
+
+	// going forward from the current canvas may be shorter
+	bool bContinue = IsInitialized() && bCanonical && NextFrame <= FrameIndex && NextFrame >= Start;
+	if (!bContinue)
+	{
+		if (Start == 0)
+		{
+			Reset();
+		}
+		else
+		{
+			InitCanvasSize();
+			Canvas = FrameCache->Keyframes[Start / FrameCache->KeyframeInterval];
+			NextFrame = Start;
+			bCanonical = true;
+			MarkAllDirty();
+		}
+	}
+
+	while (NextFrame < FrameIndex)
+	{
+		int32 Index = NextFrame;
+		if (!ComposeFrame(Index))
+			NextFrame = Index + 1;	// keep going, the frame is simply missing
+		DisposeFrame();
+	}// end of while
+}
+
+void FAnimatedTextureCompositor::AdvanceTo(int32 FrameIndex)
+{
+	DisposeFrame();
+
+	const int32 NumFrame = Owner->GetFrameCount();
+	int32 Cursor = IsInitialized() && NextFrame < NumFrame ? NextFrame : 0;
+
+	int32 Steps = FrameIndex >= Cursor ? FrameIndex - Cursor : NumFrame - Cursor + FrameIndex;
+	int32 Start = FindKeyframe(FrameIndex);
+	if (Start > 0 && FrameIndex - Start < Steps)
+	{
+		SeekTo(FrameIndex);
+		return;
+	}
+
+	for (; Steps > 0; Steps--)
+	{
+		ComposeFrame(Cursor);
+		DisposeFrame();
+		Cursor = (Cursor + 1) % NumFrame;
+	}// end of for
+}
+
+FIntRect FAnimatedTextureCompositor::ConsumeDirtyRect()
+{
+	FIntRect Rect = DirtyRect;
+	DirtyRect = FIntRect();
+	return Rect;
+}
+
+SIZE_T FAnimatedTextureCompositor::GetAllocatedSize() const
+{
+	return Canvas.GetAllocatedSize() + Restore.GetAllocatedSize() + ScratchIndices.GetAllocatedSize();
+}
+
+FIntRect FAnimatedTextureCompositor::ToCanvasRect(const FIntRect& Rect) const
+{
+	if (Scale == 0)
+		return Rect;
+
+	// pixels whose sample point, their top left corner in the GIF, is inside Rect
+	const int32 Step = 1 << Scale;
+	return FIntRect(
+		FMath::DivideAndRoundUp(Rect.Min.X, Step), FMath::DivideAndRoundUp(Rect.Min.Y, Step),
+		FMath::DivideAndRoundUp(Rect.Max.X, Step), FMath::DivideAndRoundUp(Rect.Max.Y, Step));
+}
+
+void FAnimatedTextureCompositor::AddDirtyRect(const FIntRect& Rect)
+{
+	if (Rect.Area() <= 0)
+		return;
+
+	if (DirtyRect.Area() <= 0)
+		DirtyRect = Rect;
+	else
+		DirtyRect.Union(Rect);
+}
+
+int32 FAnimatedTextureCompositor::FindKeyframe(int32 FrameIndex) const
+{
+	if (!FrameCache.IsValid() || FrameCache->Keyframes.Num() == 0 || FrameCache->KeyframeScale != Scale)
+		return 0;
+
+	const TArray<TArray<FColor>>& Keyframes = FrameCache->Keyframes;
+	const int32 Interval = FrameCache->KeyframeInterval;
+	for (int32 Key = FMath::Min(FrameIndex / Interval, Keyframes.Num() - 1); Key > 0; Key--)
+	{
+		if (Keyframes[Key].Num() > 0)
+			return Key * Interval;
+	}// end of for
+	return 0;
+}
+
+void FAnimatedTextureCompositor::CaptureKeyframe()
+{
+	if (!FrameCache.IsValid() || FrameCache->Keyframes.Num() == 0 || FrameCache->KeyframeScale != Scale)
+		return;
+
+	const int32 Interval = FrameCache->KeyframeInterval;
+	if (NextFrame % Interval != 0)
+		return;
+
+	TArray<FColor>& Keyframe = FrameCache->Keyframes[NextFrame / Interval];
+	if (Keyframe.Num() == 0)
+		Keyframe = Canvas;
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHI.h"	// RHI
+#include "Templates/Atomic.h"	// Core
+
+class UAnimatedTexture2D;
+
+/**
+ * Render thread data derived from one parsed frame set of a UAnimatedTexture2D,
+ * shared by every resource playing it: the asset itself and all its players
+ */
+class FAnimatedTextureFrameCache
+{
+public:
+	TArray<TArray<FColor>> Keyframes;	// canvas before frame Index*KeyframeInterval is drawn, empty if not captured yet
+	int32 KeyframeInterval = 0;
+	int32 KeyframeScale = 0;	// canvas scale the keyframes were captured at, other scales do not use them
+
+	TArray<FTexture2DRHIRef> FrameTextures;	// every composed frame, see UAnimatedTexture2D::UsesPreUploadedFrames
+	int32 FrameTextureUsers = 0;	// resources holding the frame textures, the last one to let go frees them
+	bool bFrameTexturesSRGB = false;
+
+	TArray<TArray<uint8>> FramePixels;	// decoded pixel indices per frame, handed over by the texture outside the editor
+	bool bCanEvictFramePixels = false;	// the texture's GIF file is resident, frames without pixels are decoded from it
+	bool bEvictionRequested = false;	// the game thread was asked to make the GIF file resident
+
+	/** Hand over the pixel indices of the frames, game thread before any resource uses the cache */
+	void SetFramePixels(TArray<TArray<uint8>>&& InFramePixels);
+
+	/** Decoded pixel indices of a frame, nullptr once evicted or if they were never handed over */
+	const uint8* GetFramePixels(int32 FrameIndex) const
+	{
+		return FramePixels.IsValidIndex(FrameIndex) && FramePixels[FrameIndex].Num() > 0 ? FramePixels[FrameIndex].GetData() : nullptr;
+	}
+
+	/** CPU memory of the keyframes */
+	SIZE_T GetAllocatedSize() const;
+
+	/** CPU memory of the frame pixels, any thread */
+	SIZE_T GetFramePixelsSize() const { return (SIZE_T)FramePixelsSize.Load(EMemoryOrder::Relaxed); }
+
+	/** GPU memory of the frame textures */
+	SIZE_T GetFrameTexturesSize() const;
+
+	/** Free the keyframes, they are captured again the next time playback starts over. @return bytes freed */
+	SIZE_T EvictKeyframes();
+
+	/** Free the frame pixels if they can be decoded again, see bCanEvictFramePixels. Render thread. @return bytes freed */
+	SIZE_T EvictFramePixels();
+
+private:
+	TAtomic<uint64> FramePixelsSize { 0 };	// the game thread reports it in the texture's resource size
+};
+
+typedef TSharedPtr<FAnimatedTextureFrameCache, ESPMode::ThreadSafe> FAnimatedTextureFrameCachePtr;
+
+/**
+ * Draws GIF frames onto a BGRA canvas and applies their disposal modes.
+ * The canvas can be snapshotted every KeyframeInterval frames, so seeking replays at most KeyframeInterval-1 frames.
+ * Keyframes go to the shared frame cache, so they are captured once for all players of a texture.
+ * The canvas may be smaller than the GIF by a power of two, frames are then point sampled into it.
+ */
+class ANIMATEDTEXTURE_API FAnimatedTextureCompositor
+{
+public:
+	FAnimatedTextureCompositor(const UAnimatedTexture2D* InOwner, int32 InKeyframeInterval);
+
+	/** Keyframes are stored in the cache from now on */
+	void SetFrameCache(const FAnimatedTextureFrameCachePtr& InFrameCache);
+
+	/** Canvas of 1/2^InScale the GIF size, from 0 to MaxScale. A new scale frees the canvas */
+	void SetScale(int32 InScale);
+
+	int32 GetScale() const { return Scale; }
+
+	static const int32 MaxScale = 3;
+
+	/** Canvas size of a GIF size at Scale */
+	static uint32 GetScaledSize(uint32 Size, int32 Scale)
+	{
+		return (Size + (1u << Scale) - 1) >> Scale;
+	}
+
+	/** Clear the canvas to the background color, ready to draw frame 0 */
+	void Reset();
+
+	/** Free the canvas, the next ComposeFrame starts over from Reset */
+	void Empty();
+
+	bool IsInitialized() const { return Canvas.Num() > 0; }
+
+	/** Have the whole canvas uploaded again, e.g. after the RHI texture was recreated */
+	void MarkAllDirty();
+
+	/** Draw a frame on the canvas, returns false if the frame can not be decoded */
+	bool ComposeFrame(int32 FrameIndex);
+
+	/** Apply the disposal mode of the frame drawn last, the canvas is then ready for the next one */
+	void DisposeFrame();
+
+	/** Bring the canvas to the state right before FrameIndex is drawn, starting from the nearest keyframe */
+	void SeekTo(int32 FrameIndex);
+
+	/**
+	 * Bring the canvas to the state right before FrameIndex is drawn, as if playback went through every frame in between,
+	 * wrapping around the last frame. Jumps to a keyframe instead when that replays fewer frames.
+	 */
+	void AdvanceTo(int32 FrameIndex);
+
+	/** Index of the frame the canvas is ready to draw */
+	int32 GetNextFrame() const { return NextFrame; }
+
+	/** Canvas area changed since the last call */
+	FIntRect ConsumeDirtyRect();
+
+	const FColor* GetCanvas() const { return Canvas.GetData(); }
+	uint32 GetWidth() const { return Width; }
+	uint32 GetHeight() const { return Height; }
+
+	/** CPU memory held by the canvas, the shared keyframes are not included */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	/** Canvas size at the current scale, sizes the restore buffer to match */
+	void InitCanvasSize();
+	void AddDirtyRect(const FIntRect& Rect);
+
+	/** Canvas pixels sampling a rect of the GIF logical screen */
+	FIntRect ToCanvasRect(const FIntRect& Rect) const;
+	void CaptureKeyframe();
+
+	/** First frame of the nearest captured keyframe at or before FrameIndex, 0 if none */
+	int32 FindKeyframe(int32 FrameIndex) const;
+
+private:
+	const UAnimatedTexture2D* Owner;
+	uint32 Width;
+	uint32 Height;
+	int32 Scale;	// canvas pixel (X, Y) shows GIF pixel (X << Scale, Y << Scale)
+
+	TArray<FColor> Canvas;
+	TArray<FColor> Restore;	// the area a GIF_PREV frame covered
+	TArray<uint8> ScratchIndices;	// frame decoded on demand
+	FIntRect DirtyRect;
+
+	int32 NextFrame;
+	bool bCanonical;	// canvas is what playing from frame 0 gives, false after a loop wrapped around
+
+	// disposal of the frame drawn last
+	int32 LastFrame;
+	FIntRect LastFrameRect;
+
+	int32 KeyframeInterval;	// 0: no keyframes
+	FAnimatedTextureFrameCachePtr FrameCache;
+};
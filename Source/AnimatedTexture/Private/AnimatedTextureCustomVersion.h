@@ -0,0 +1,43 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"	// Core
+
+/**
+ * Custom serialization version for UAnimatedTexture2D
+ */
+struct FAnimatedTextureCustomVersion
+{
+	enum Type
+	{
+		// Before any version changes were made in the plugin
+		BeforeCustomVersionWasAdded = 0,
+
+		// Cooked packages may carry the decoded frame table
+		CookedFrameData,
+
+		// Frames record the offset of their image descriptor in RawData
+		FrameDataOffset,
+
+		// Frames reference a deduplicated palette table instead of keeping a copy
+		SharedPalettes,
+
+		// The GIF file is bulk data instead of the RawData property
+		GIFBulkData,
+
+		// Cooked packages may carry every composed frame block compressed
+		CompressedFrames,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	// The GUID for this custom version number
+	const static FGuid GUID;
+
+private:
+	FAnimatedTextureCustomVersion() {}
+};
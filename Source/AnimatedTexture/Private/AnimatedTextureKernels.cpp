@@ -0,0 +1,364 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTextureKernels.h"
+#include "AnimatedTextureModule.h"
+
+#include "HAL/IConsoleManager.h"	// Core
+#include "Math/RandomStream.h"	// Core
+#include "Templates/Atomic.h"	// Core
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define ANIMTEX_KERNELS_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#else
+	#define ANIMTEX_KERNELS_X86 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+	#define ANIMTEX_KERNELS_NEON 1
+	#include <arm_neon.h>
+#else
+	#define ANIMTEX_KERNELS_NEON 0
+#endif
+
+// let clang/gcc emit instructions above the module's target ISA in these functions only
+#if ANIMTEX_KERNELS_X86 && (defined(__clang__) || defined(__GNUC__))
+	#define ANIMTEX_TARGET_SSE41 __attribute__((target("sse4.1")))
+	#define ANIMTEX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define ANIMTEX_TARGET_SSE41
+	#define ANIMTEX_TARGET_AVX2
+#endif
+
+typedef void(*FExpandPaletteIndicesFunc)(FColor*, const uint8*, uint32, const FColor*, int32);
+typedef void(*FFillColorFunc)(FColor*, uint32, FColor);
+
+struct FAnimatedTextureKernelSet
+{
+	const TCHAR* Name;
+	FExpandPaletteIndicesFunc ExpandPaletteIndices;
+	FFillColorFunc FillColor;
+};
+
+//-- scalar, the reference for every other kernel set
+
+static void ExpandPaletteIndices_Scalar(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex)
+{
+	for (uint32 i = 0; i < Count; i++)
+	{
+		uint8 ColorIndex = Indices[i];
+		if (ColorIndex != TransparentIndex)
+			Dest[i] = Palette[ColorIndex];
+	}// end of for
+}
+
+static void FillColor_Scalar(FColor* Dest, uint32 Count, FColor Color)
+{
+	for (uint32 i = 0; i < Count; i++)
+		Dest[i] = Color;
+}
+
+#if ANIMTEX_KERNELS_X86
+
+//-- SSE4.1: 4 pixels per step, palette lookups are scalar loads
+
+ANIMTEX_TARGET_SSE41 static void ExpandPaletteIndices_SSE41(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex)
+{
+	const int32* Pal = (const int32*)Palette;
+	const __m128i Transparent = _mm_set1_epi32(TransparentIndex);	// -1 never equals an index
+
+	uint32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+	{
+		const uint8* Idx = Indices + i;
+		__m128i IndexVec = _mm_setr_epi32(Idx[0], Idx[1], Idx[2], Idx[3]);
+		__m128i Colors = _mm_setr_epi32(Pal[Idx[0]], Pal[Idx[1]], Pal[Idx[2]], Pal[Idx[3]]);
+		__m128i Skip = _mm_cmpeq_epi32(IndexVec, Transparent);
+
+		__m128i* DestVec = (__m128i*)(Dest + i);
+		if (_mm_testz_si128(Skip, Skip))
+			_mm_storeu_si128(DestVec, Colors);
+		else
+			_mm_storeu_si128(DestVec, _mm_blendv_epi8(Colors, _mm_loadu_si128(DestVec), Skip));
+	}// end of for
+
+	ExpandPaletteIndices_Scalar(Dest + i, Indices + i, Count - i, Palette, TransparentIndex);
+}
+
+ANIMTEX_TARGET_SSE41 static void FillColor_SSE41(FColor* Dest, uint32 Count, FColor Color)
+{
+	const __m128i ColorVec = _mm_set1_epi32((int32)Color.DWColor());
+
+	uint32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+		_mm_storeu_si128((__m128i*)(Dest + i), ColorVec);
+
+	FillColor_Scalar(Dest + i, Count - i, Color);
+}
+
+//-- AVX2: 8 pixels per step with a hardware gather
+
+ANIMTEX_TARGET_AVX2 static void ExpandPaletteIndices_AVX2(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex)
+{
+	const int* Pal = (const int*)Palette;
+	const __m256i Transparent = _mm256_set1_epi32(TransparentIndex);
+
+	uint32 i = 0;
+	for (; i + 8 <= Count; i += 8)
+	{
+		__m256i IndexVec = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Indices + i)));
+		__m256i Colors = _mm256_i32gather_epi32(Pal, IndexVec, 4);
+		__m256i Skip = _mm256_cmpeq_epi32(IndexVec, Transparent);
+
+		__m256i* DestVec = (__m256i*)(Dest + i);
+		if (_mm256_testz_si256(Skip, Skip))
+			_mm256_storeu_si256(DestVec, Colors);
+		else
+			_mm256_storeu_si256(DestVec, _mm256_blendv_epi8(Colors, _mm256_loadu_si256(DestVec), Skip));
+	}// end of for
+
+	ExpandPaletteIndices_Scalar(Dest + i, Indices + i, Count - i, Palette, TransparentIndex);
+}
+
+ANIMTEX_TARGET_AVX2 static void FillColor_AVX2(FColor* Dest, uint32 Count, FColor Color)
+{
+	const __m256i ColorVec = _mm256_set1_epi32((int32)Color.DWColor());
+
+	uint32 i = 0;
+	for (; i + 8 <= Count; i += 8)
+		_mm256_storeu_si256((__m256i*)(Dest + i), ColorVec);
+
+	FillColor_Scalar(Dest + i, Count - i, Color);
+}
+
+static void CPUID(int32 Leaf, int32 SubLeaf, int32 Regs[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(Regs, Leaf, SubLeaf);
+#else
+	unsigned int A = 0, B = 0, C = 0, D = 0;
+	__cpuid_count(Leaf, SubLeaf, A, B, C, D);
+	Regs[0] = A; Regs[1] = B; Regs[2] = C; Regs[3] = D;
+#endif
+}
+
+static bool HasSSE41()
+{
+	int32 Regs[4];
+	CPUID(1, 0, Regs);
+	return (Regs[2] & (1 << 19)) != 0;
+}
+
+static bool HasAVX2()
+{
+	int32 Regs[4];
+	CPUID(0, 0, Regs);
+	if (Regs[0] < 7)
+		return false;
+
+	// the OS must save the YMM registers too
+	CPUID(1, 0, Regs);
+	const bool bOSXSAVE = (Regs[2] & (1 << 27)) != 0;
+	const bool bAVX = (Regs[2] & (1 << 28)) != 0;
+	if (!bOSXSAVE || !bAVX)
+		return false;
+
+#if defined(_MSC_VER)
+	const uint64 XCR0 = _xgetbv(0);
+#else
+	uint32 XCR0Low = 0, XCR0High = 0;
+	__asm__ volatile("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+	const uint64 XCR0 = ((uint64)XCR0High << 32) | XCR0Low;
+#endif
+	if ((XCR0 & 0x6) != 0x6)
+		return false;
+
+	CPUID(7, 0, Regs);
+	return (Regs[1] & (1 << 5)) != 0;
+}
+
+#endif // ANIMTEX_KERNELS_X86
+
+#if ANIMTEX_KERNELS_NEON
+
+//-- NEON: 4 pixels per step, palette lookups are scalar loads
+
+static void ExpandPaletteIndices_NEON(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex)
+{
+	const uint32* Pal = (const uint32*)Palette;
+	const uint32x4_t Transparent = vdupq_n_u32((uint32)TransparentIndex);
+
+	uint32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+	{
+		const uint8* Idx = Indices + i;
+		const uint32 IndexArray[4] = { Idx[0], Idx[1], Idx[2], Idx[3] };
+		const uint32 ColorArray[4] = { Pal[Idx[0]], Pal[Idx[1]], Pal[Idx[2]], Pal[Idx[3]] };
+
+		uint32x4_t Skip = vceqq_u32(vld1q_u32(IndexArray), Transparent);
+		uint32* DestVec = (uint32*)(Dest + i);
+		vst1q_u32(DestVec, vbslq_u32(Skip, vld1q_u32(DestVec), vld1q_u32(ColorArray)));
+	}// end of for
+
+	ExpandPaletteIndices_Scalar(Dest + i, Indices + i, Count - i, Palette, TransparentIndex);
+}
+
+static void FillColor_NEON(FColor* Dest, uint32 Count, FColor Color)
+{
+	const uint32x4_t ColorVec = vdupq_n_u32(Color.DWColor());
+
+	uint32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+		vst1q_u32((uint32*)(Dest + i), ColorVec);
+
+	FillColor_Scalar(Dest + i, Count - i, Color);
+}
+
+#endif // ANIMTEX_KERNELS_NEON
+
+//-- one immutable table per kernel set
+
+static const FAnimatedTextureKernelSet GScalarKernels = { TEXT("Scalar"), &ExpandPaletteIndices_Scalar, &FillColor_Scalar };
+#if ANIMTEX_KERNELS_X86
+static const FAnimatedTextureKernelSet GSSE41Kernels = { TEXT("SSE4.1"), &ExpandPaletteIndices_SSE41, &FillColor_SSE41 };
+static const FAnimatedTextureKernelSet GAVX2Kernels = { TEXT("AVX2"), &ExpandPaletteIndices_AVX2, &FillColor_AVX2 };
+#endif
+#if ANIMTEX_KERNELS_NEON
+static const FAnimatedTextureKernelSet GNEONKernels = { TEXT("NEON"), &ExpandPaletteIndices_NEON, &FillColor_NEON };
+#endif
+
+// swapped as a whole while the render thread and the decode workers call through it, so a call never mixes two sets
+static TAtomic<const FAnimatedTextureKernelSet*> GKernels(&GScalarKernels);
+
+static void GetSupportedKernels(TArray<const FAnimatedTextureKernelSet*>& OutKernels)
+{
+#if ANIMTEX_KERNELS_X86
+	if (HasAVX2())
+		OutKernels.Add(&GAVX2Kernels);
+	if (HasSSE41())
+		OutKernels.Add(&GSSE41Kernels);
+#endif
+#if ANIMTEX_KERNELS_NEON
+	OutKernels.Add(&GNEONKernels);
+#endif
+}
+
+static bool ValidateKernelSet(const FAnimatedTextureKernelSet& Kernels)
+{
+	FRandomStream Random(0x41544558);
+
+	FColor Palette[256];
+	for (int32 i = 0; i < 256; i++)
+		Palette[i] = FColor(Random.GetUnsignedInt());
+
+	// odd lengths exercise the scalar tails
+	const uint32 Lengths[] = { 0, 1, 3, 4, 7, 8, 15, 16, 31, 33, 255, 1024 + 5 };
+	const int32 TransparentIndices[] = { -1, 0, 7, 255 };
+
+	TArray<uint8> Indices;
+	TArray<FColor> Expected, Actual;
+	for (uint32 Count : Lengths)
+	{
+		Indices.SetNumUninitialized(Count);
+		for (uint32 i = 0; i < Count; i++)
+			Indices[i] = (uint8)(Random.RandHelper(4) == 0 ? 7 : Random.RandHelper(256));
+
+		for (int32 TransparentIndex : TransparentIndices)
+		{
+			Expected.SetNumUninitialized(Count);
+			for (uint32 i = 0; i < Count; i++)
+				Expected[i] = FColor(Random.GetUnsignedInt());
+			Actual = Expected;
+
+			ExpandPaletteIndices_Scalar(Expected.GetData(), Indices.GetData(), Count, Palette, TransparentIndex);
+			Kernels.ExpandPaletteIndices(Actual.GetData(), Indices.GetData(), Count, Palette, TransparentIndex);
+			if (Expected != Actual)
+				return false;
+		}
+
+		const FColor FillValue(Random.GetUnsignedInt());
+		FillColor_Scalar(Expected.GetData(), Count, FillValue);
+		Kernels.FillColor(Actual.GetData(), Count, FillValue);
+		if (Expected != Actual)
+			return false;
+	}// end of for
+
+	return true;
+}
+
+static int32 GAnimatedTextureSIMD = 1;
+static void OnAnimatedTextureSIMDChanged(IConsoleVariable* Var)
+{
+	InitAnimatedTextureKernels();
+}
+static FAutoConsoleVariableRef CVarAnimatedTextureSIMD(
+	TEXT("r.AnimatedTexture.SIMD"),
+	GAnimatedTextureSIMD,
+	TEXT("0: composite animated texture frames with the scalar kernels.\n")
+	TEXT("1: use the fastest SIMD kernels this CPU supports (default)."),
+	FConsoleVariableDelegate::CreateStatic(&OnAnimatedTextureSIMDChanged),
+	ECVF_Default);
+
+void InitAnimatedTextureKernels()
+{
+	const FAnimatedTextureKernelSet* Kernels = &GScalarKernels;
+	if (GAnimatedTextureSIMD != 0)
+	{
+		TArray<const FAnimatedTextureKernelSet*> Supported;
+		GetSupportedKernels(Supported);
+		if (Supported.Num() > 0)
+		{
+			Kernels = Supported[0];
+#if !UE_BUILD_SHIPPING
+			if (!ValidateKernelSet(*Kernels))
+			{
+				UE_LOG(LogAnimTexture, Error, TEXT("%s kernels do not match the scalar output, falling back to scalar."), Kernels->Name);
+				Kernels = &GScalarKernels;
+			}
+#endif
+		}
+	}
+
+	GKernels.Store(Kernels);
+	UE_LOG(LogAnimTexture, Log, TEXT("Animated texture compositor uses %s kernels."), Kernels->Name);
+}
+
+const TCHAR* GetAnimatedTextureKernelsName()
+{
+	return GKernels.Load()->Name;
+}
+
+bool ValidateAnimatedTextureKernels()
+{
+	TArray<const FAnimatedTextureKernelSet*> Supported;
+	GetSupportedKernels(Supported);
+
+	bool bAllPassed = true;
+	for (const FAnimatedTextureKernelSet* Kernels : Supported)
+	{
+		bool bPassed = ValidateKernelSet(*Kernels);
+		UE_LOG(LogAnimTexture, Display, TEXT("%s kernels: %s"), Kernels->Name, bPassed ? TEXT("bit-exact") : TEXT("MISMATCH"));
+		bAllPassed &= bPassed;
+	}
+	return bAllPassed;
+}
+
+static FAutoConsoleCommand CmdAnimatedTextureValidateKernels(
+	TEXT("AnimatedTexture.ValidateKernels"),
+	TEXT("Check every SIMD kernel set this CPU supports against the scalar kernels."),
+	FConsoleCommandDelegate::CreateLambda([]() { ValidateAnimatedTextureKernels(); }));
+
+void ExpandPaletteIndices(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex)
+{
+	GKernels.Load(EMemoryOrder::Relaxed)->ExpandPaletteIndices(Dest, Indices, Count, Palette, TransparentIndex);
+}
+
+void FillColor(FColor* Dest, uint32 Count, FColor Color)
+{
+	GKernels.Load(EMemoryOrder::Relaxed)->FillColor(Dest, Count, Color);
+}
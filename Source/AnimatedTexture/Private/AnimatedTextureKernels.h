@@ -0,0 +1,37 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Pixel kernels of the frame compositor, SSE4.1/AVX2/NEON versions are picked by CPU features
+ */
+
+/** Select the kernels for this CPU, in non-shipping builds they are checked against the scalar ones */
+void InitAnimatedTextureKernels();
+
+/** Name of the selected kernel set, e.g. "AVX2" */
+ANIMATEDTEXTURE_API const TCHAR* GetAnimatedTextureKernelsName();
+
+/** Compare every kernel set this CPU supports with the scalar kernels, true if all are bit-exact */
+bool ValidateAnimatedTextureKernels();
+
+/**
+ * Dest[i] = Palette[Indices[i]] for each index that is not TransparentIndex
+ * @param Palette	256 entries, whatever the size of the GIF palette
+ * @param TransparentIndex	-1 when the frame is opaque
+ */
+void ExpandPaletteIndices(FColor* Dest, const uint8* Indices, uint32 Count, const FColor* Palette, int32 TransparentIndex);
+
+/** Dest[i] = Color */
+void FillColor(FColor* Dest, uint32 Count, FColor Color);
@@ -0,0 +1,377 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTextureManager.h"
+#include "AnimatedTextureResource.h"
+#include "AnimatedTexture2D.h"
+#include "AnimatedTextureModule.h"
+
+#include "HAL/IConsoleManager.h"	// Core
+#include "Async/Async.h"	// Core
+
+#if WITH_EDITOR
+#include "Misc/ConfigCacheIni.h"	// Core
+#include "Interfaces/ITargetPlatform.h"	// TargetPlatform
+#endif
+
+static const TCHAR* MemoryBudgetCVarName = TEXT("r.AnimatedTexture.MemoryBudgetMB");
+
+static TAutoConsoleVariable<int32> CVarAnimatedTextureMemoryBudget(
+	MemoryBudgetCVarName,
+	0,
+	TEXT("CPU memory for decoded animated texture data: frame pixels, canvases and keyframes, 0 is unlimited.\n")
+	TEXT("Least recently rendered textures are evicted down to their GIF data first and rebuilt when they play again.\n")
+	TEXT("Set it per platform in the device profiles or the platform engine ini, the cook only keeps the GIF data of\n")
+	TEXT("textures with cooked frames for platforms that set it."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAnimatedTextureMaxUploadsPerFrame(
+	TEXT("r.AnimatedTexture.MaxUploadsPerFrame"),
+	0,
+	TEXT("Most animated textures written per frame, 0 is unlimited.\n")
+	TEXT("The most significant textures go first, the others catch up on the next frames."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAnimatedTextureLowSignificanceInterval(
+	TEXT("r.AnimatedTexture.LowSignificanceInterval"),
+	0.25f,
+	TEXT("Seconds between frame changes of an animated texture reported at zero screen size,\n")
+	TEXT("textures drawn at full size play at their own rate, the ones in between are interpolated."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAnimatedTextureVisibilityTimeout(
+	TEXT("r.AnimatedTexture.VisibilityTimeout"),
+	2.5f,
+	TEXT("Animated textures hold their frame after not being rendered for this many seconds."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAnimatedTextureIdleReleaseTimeout(
+	TEXT("r.AnimatedTexture.IdleReleaseTimeout"),
+	30.0f,
+	TEXT("Seconds an animated texture may go without being rendered before its canvas is freed and its texture shrinks to 1x1,\n")
+	TEXT("both are rebuilt when it is rendered again. 0 keeps them forever."),
+	ECVF_Default);
+
+static const float BudgetCheckInterval = 1.0f;	// sec
+
+FAnimatedTextureManager& FAnimatedTextureManager::Get()
+{
+	check(IsInRenderingThread());
+
+	static FAnimatedTextureManager Manager;
+	return Manager;
+}
+
+FAnimatedTextureManager::FAnimatedTextureManager()
+	:FTickableObjectRenderThread(false, true),
+	TimeSinceBudgetCheck(0.0f)
+{
+}
+
+int32 FAnimatedTextureManager::Add(FAnimatedTextureResource* Resource)
+{
+	check(IsInRenderingThread());
+
+	if (Playbacks.Num() == 0)
+		Register();
+
+	FAnimatedTexturePlayback Playback;
+	Playback.Resource = Resource;
+	return Playbacks.Add(Playback);
+}
+
+void FAnimatedTextureManager::Remove(int32 Handle)
+{
+	check(IsInRenderingThread());
+
+	Playbacks.RemoveAtSwap(Handle, 1, false);
+	if (Handle < Playbacks.Num())
+		Playbacks[Handle].Resource->SetPlaybackHandle(Handle);
+
+	if (Playbacks.Num() == 0)
+		Unregister();
+}
+
+float FAnimatedTextureManager::GetVisibilityTimeout()
+{
+	return CVarAnimatedTextureVisibilityTimeout.GetValueOnRenderThread();
+}
+
+#if WITH_EDITOR
+bool FAnimatedTextureManager::HasMemoryBudget(const ITargetPlatform* TargetPlatform)
+{
+	// read once per platform, every texture of the cook asks
+	static TMap<FString, bool> PlatformBudgets;
+	const FString PlatformName = TargetPlatform->IniPlatformName();
+	if (const bool* bHasBudget = PlatformBudgets.Find(PlatformName))
+		return *bHasBudget;
+
+	int32 Budget = 0;
+	FConfigFile EngineIni;
+	FConfigCacheIni::LoadLocalIniFile(EngineIni, TEXT("Engine"), true, *PlatformName);
+	EngineIni.GetInt(TEXT("SystemSettings"), MemoryBudgetCVarName, Budget);
+	if (Budget <= 0)
+		EngineIni.GetInt(TEXT("ConsoleVariables"), MemoryBudgetCVarName, Budget);
+
+	// device profiles of the platform, e.g. +CVars=r.AnimatedTexture.MemoryBudgetMB=64
+	FConfigFile DeviceProfilesIni;
+	FConfigCacheIni::LoadLocalIniFile(DeviceProfilesIni, TEXT("DeviceProfiles"), true, *PlatformName);
+	for (const TPair<FString, FConfigSection>& Section : DeviceProfilesIni)
+	{
+		if (Budget > 0)
+			break;
+
+		const FConfigValue* DeviceType = Section.Value.Find(TEXT("DeviceType"));
+		if (DeviceType == nullptr || DeviceType->GetValue() != PlatformName)
+			continue;
+
+		TArray<FConfigValue> CVars;
+		Section.Value.MultiFind(TEXT("CVars"), CVars);
+		for (const FConfigValue& CVar : CVars)
+		{
+			FString Name, Value;
+			if (CVar.GetValue().Split(TEXT("="), &Name, &Value) && Name.TrimStartAndEnd() == MemoryBudgetCVarName)
+				Budget = FMath::Max(Budget, FCString::Atoi(*Value));
+		}// end of for
+	}// end of for
+
+	PlatformBudgets.Add(PlatformName, Budget > 0);
+	return Budget > 0;
+}
+#endif // WITH_EDITOR
+
+float FAnimatedTextureManager::GetLowSignificanceInterval()
+{
+	return FMath::Max(CVarAnimatedTextureLowSignificanceInterval.GetValueOnRenderThread(), 0.0f);
+}
+
+void FAnimatedTextureManager::Tick(float DeltaTime)
+{
+	TimeSinceBudgetCheck += DeltaTime;
+	if (TimeSinceBudgetCheck >= BudgetCheckInterval)
+	{
+		TimeSinceBudgetCheck = 0.0f;
+		ReleaseIdleTextures();
+		EnforceMemoryBudget();
+		UpdateMemoryStats();
+	}
+
+	//-- advance all clocks, collect the ones leaving their frame
+	DuePlaybacks.Reset();
+	int32 NumTicking = 0;
+	for (int32 i = 0; i < Playbacks.Num(); i++)
+	{
+		FAnimatedTexturePlayback& Playback = Playbacks[i];
+		if (Playback.bIdleReleased)
+		{
+			// the 1x1 placeholder was sampled, bring the texture back before it is seen
+			if (!Playback.Resource->WasRecentlyRendered())
+				continue;
+			Playback.Resource->RestoreIdleData();
+		}
+
+		if (Playback.PlayRate != 0.0f)
+			NumTicking++;
+		Playback.Elapsed += DeltaTime * Playback.PlayRate;
+		Playback.SinceUpdate += DeltaTime;
+		if ((Playback.Elapsed < Playback.WindowMin || Playback.Elapsed >= Playback.WindowMax) && Playback.SinceUpdate >= Playback.MinUpdateInterval)
+			DuePlaybacks.Add(i);
+	}// end of for
+
+	int32 MaxUploads = CVarAnimatedTextureMaxUploadsPerFrame.GetValueOnRenderThread();
+	if (MaxUploads > 0 && DuePlaybacks.Num() > MaxUploads)
+	{
+		DuePlaybacks.Sort([this](int32 A, int32 B)
+		{
+			return Playbacks[A].Significance > Playbacks[B].Significance;
+		});
+	}
+
+	//-- compose and upload the new frames
+	int32 NumUploads = 0;
+	int32 NumUpdated = 0;
+	for (int32 Index : DuePlaybacks)
+	{
+		FAnimatedTexturePlayback& Playback = Playbacks[Index];
+		FAnimatedTextureResource* Resource = Playback.Resource;
+
+		// hidden textures hold their frame until they are seen again
+		if (!Playback.bAlwaysTickEvenNoSee && !Resource->WasRecentlyRendered())
+		{
+			Playback.Elapsed -= DeltaTime * Playback.PlayRate;
+			continue;
+		}
+
+		// the rest keep their clock running and catch up on a later frame
+		if (MaxUploads > 0 && NumUploads >= MaxUploads)
+			break;
+
+		if (Resource->TickAnim(Playback.Elapsed))
+			NumUpdated++;
+		Playback.Elapsed = 0.0f;
+		Playback.SinceUpdate = 0.0f;
+		Resource->GetFrameWindow(Playback.WindowMin, Playback.WindowMax);
+
+		if (Resource->GetLastUploadBytes() > 0)
+			NumUploads++;
+	}// end of for
+
+	SET_DWORD_STAT(STAT_AnimTexActive, Playbacks.Num());
+	SET_DWORD_STAT(STAT_AnimTexTicking, NumTicking);
+	SET_DWORD_STAT(STAT_AnimTexUpdated, NumUpdated);
+	CSV_CUSTOM_STAT(AnimatedTexture, ActiveTextures, Playbacks.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(AnimatedTexture, TickingTextures, NumTicking, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(AnimatedTexture, UpdatedTextures, NumUpdated, ECsvCustomStatOp::Set);
+}
+
+void FAnimatedTextureManager::UpdateMemoryStats()
+{
+#if STATS || CSV_PROFILER
+	SIZE_T FrameDataSize = 0;
+	SIZE_T PaletteSize = 0;
+	SIZE_T FramebufferSize = 0;
+	SIZE_T RHISize = 0;
+
+	TSet<UAnimatedTexture2D*> FrameSets;
+	for (const FAnimatedTexturePlayback& Playback : Playbacks)
+	{
+		FAnimatedTextureResource* Resource = Playback.Resource;
+		FramebufferSize += Resource->GetDecodedDataSize();
+		RHISize += Resource->GetTextureMemorySize();
+
+		// the async parse may still be handing its frames to the owner on the game thread
+		if (!Resource->AreFramesReady())
+			continue;
+
+		// the frames, palettes and frame cache are shared by a texture and its players
+		bool bAlreadyCounted = false;
+		FrameSets.Add(Resource->GetOwner(), &bAlreadyCounted);
+		if (bAlreadyCounted)
+			continue;
+
+		UAnimatedTexture2D* Owner = Resource->GetOwner();
+		FrameDataSize += Owner->GetFramePixelsSize() + Owner->GetGIFDataSize() + Owner->GetCompressedFramesSize();
+		PaletteSize += Owner->GetPalettesSize();
+		if (FAnimatedTextureFrameCache* FrameCache = Resource->GetFrameCache())
+		{
+			FrameDataSize += FrameCache->GetFramePixelsSize();
+			FramebufferSize += FrameCache->GetAllocatedSize();
+			RHISize += FrameCache->GetFrameTexturesSize();
+		}
+	}// end of for
+
+	SET_MEMORY_STAT(STAT_AnimTexFrameDataMemory, FrameDataSize);
+	SET_MEMORY_STAT(STAT_AnimTexPaletteMemory, PaletteSize);
+	SET_MEMORY_STAT(STAT_AnimTexFramebufferMemory, FramebufferSize);
+	SET_MEMORY_STAT(STAT_AnimTexRHIMemory, RHISize);
+
+	const float MB = 1.0f / (1024.0f * 1024.0f);
+	CSV_CUSTOM_STAT(AnimatedTexture, FrameDataMB, FrameDataSize * MB, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(AnimatedTexture, PalettesMB, PaletteSize * MB, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(AnimatedTexture, FramebuffersMB, FramebufferSize * MB, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(AnimatedTexture, RHIMB, RHISize * MB, ECsvCustomStatOp::Set);
+#endif // STATS || CSV_PROFILER
+}
+
+void FAnimatedTextureManager::ReleaseIdleTextures()
+{
+	const float Timeout = CVarAnimatedTextureIdleReleaseTimeout.GetValueOnRenderThread();
+	if (Timeout <= 0.0f)
+		return;
+
+	for (int32 i = 0; i < Playbacks.Num(); i++)
+	{
+		FAnimatedTexturePlayback& Playback = Playbacks[i];
+		if (Playback.bIdleReleased || Playback.bAlwaysTickEvenNoSee)
+			continue;
+
+		if (Playback.Resource->GetIdleTime() > Timeout)
+			Playback.Resource->ReleaseIdleData();
+	}// end of for
+}
+
+void FAnimatedTextureManager::EnforceMemoryBudget()
+{
+	const int64 Budget = (int64)CVarAnimatedTextureMemoryBudget.GetValueOnRenderThread() * 1024 * 1024;
+	if (Budget <= 0)
+		return;
+
+	//-- gather what is decoded
+	DecodedData.Reset();
+	TMap<UAnimatedTexture2D*, int32> FrameSets;
+	int64 Total = 0;
+
+	for (const FAnimatedTexturePlayback& Playback : Playbacks)
+	{
+		FAnimatedTextureResource* Resource = Playback.Resource;
+		if (!Resource->AreFramesReady())
+			continue;
+
+		double LastRenderTime = Resource->GetLastRenderTime();
+		bool bInUse = Playback.PlayRate != 0.0f && (Playback.bAlwaysTickEvenNoSee || Resource->WasRecentlyRendered());
+
+		FDecodedData Canvas = { LastRenderTime, Resource->GetDecodedDataSize(), Resource, nullptr, nullptr, bInUse };
+		DecodedData.Add(Canvas);
+		Total += Canvas.Size;
+
+		UAnimatedTexture2D* Owner = Resource->GetOwner();
+		if (int32* FrameSetIndex = FrameSets.Find(Owner))
+		{
+			FDecodedData& FrameSet = DecodedData[*FrameSetIndex];
+			FrameSet.LastRenderTime = FMath::Max(FrameSet.LastRenderTime, LastRenderTime);
+		}
+		else
+		{
+			FAnimatedTextureFrameCache* FrameCache = Resource->GetFrameCache();
+			SIZE_T Size = Owner->GetFramePixelsSize() + (FrameCache ? FrameCache->GetFramePixelsSize() + FrameCache->GetAllocatedSize() : 0);
+
+			FDecodedData FrameSet = { LastRenderTime, Size, nullptr, Owner, FrameCache, false };
+			FrameSets.Add(Owner, DecodedData.Add(FrameSet));
+			Total += Size;
+		}
+	}// end of for
+
+	if (Total <= Budget)
+		return;
+
+	//-- least recently rendered first
+	DecodedData.Sort([](const FDecodedData& A, const FDecodedData& B)
+	{
+		return A.LastRenderTime < B.LastRenderTime;
+	});
+
+	for (const FDecodedData& Entry : DecodedData)
+	{
+		if (Total <= Budget)
+			break;
+		if (Entry.Size == 0 || Entry.bInUse)
+			continue;
+
+		SIZE_T Freed = 0;
+		if (Entry.Resource)
+		{
+			Freed = Entry.Resource->EvictDecodedData();
+		}
+		else if (Entry.FrameCache)
+		{
+			// frames of visible textures fall back to decoding from the GIF file
+			Freed = Entry.FrameCache->EvictFramePixels() + Entry.FrameCache->EvictKeyframes();
+			if (!Entry.FrameCache->bCanEvictFramePixels && !Entry.FrameCache->bEvictionRequested && Entry.FrameCache->GetFramePixelsSize() > 0)
+			{
+				// the GIF file is loaded on the game thread, the pixels go on a later check
+				Entry.FrameCache->bEvictionRequested = true;
+				TWeakObjectPtr<UAnimatedTexture2D> WeakOwner = Entry.Owner;
+				AsyncTask(ENamedThreads::GameThread, [WeakOwner]()
+				{
+					if (UAnimatedTexture2D* Texture = WeakOwner.Get())
+						Texture->AllowFramePixelsEviction();
+				});
+			}
+		}
+		Total -= Freed;
+	}// end of for
+
+	if (Total > Budget)
+	{
+		UE_LOG(LogAnimTexture, Verbose, TEXT("Animated textures in use need %lld KB, over the budget of %lld KB"), Total / 1024, Budget / 1024);
+	}
+}
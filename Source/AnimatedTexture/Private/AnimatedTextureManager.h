@@ -0,0 +1,110 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"	// Engine
+
+#include "AnimatedTextureStats.h"
+
+class FAnimatedTextureResource;
+class FAnimatedTextureFrameCache;
+class UAnimatedTexture2D;
+class ITargetPlatform;
+
+/** Playback clock of one animated texture, kept small so the manager walks them in a tight loop */
+struct FAnimatedTexturePlayback
+{
+	FAnimatedTextureResource* Resource = nullptr;
+	float PlayRate = 0.0f;	// 0 while stopped
+	float Elapsed = 0.0f;	// animation time since the frame window was computed
+	float WindowMin = 0.0f;	// the frame stays the same while Elapsed is in [WindowMin, WindowMax)
+	float WindowMax = 0.0f;
+	float SinceUpdate = 0.0f;	// real time since the texture last changed frame
+	float MinUpdateInterval = 0.0f;	// from the update rate cap and the significance
+	float Significance = 1.0f;	// 0..1, higher updates first when uploads are limited
+	bool bAlwaysTickEvenNoSee = false;
+	bool bIdleReleased = false;	// canvas and texture freed until the texture is rendered again
+};
+
+/**
+ * Ticks every animated texture on the render thread in one pass,
+ * only the textures whose frame changed are composed and uploaded, the most significant first
+ * when r.AnimatedTexture.MaxUploadsPerFrame limits them.
+ * Also keeps the decoded data of all textures within r.AnimatedTexture.MemoryBudgetMB
+ * and releases the textures nobody has looked at for r.AnimatedTexture.IdleReleaseTimeout.
+ */
+class FAnimatedTextureManager : public FTickableObjectRenderThread
+{
+public:
+	static FAnimatedTextureManager& Get();
+
+	FAnimatedTextureManager();
+
+	/** @return handle of the new playback record */
+	int32 Add(FAnimatedTextureResource* Resource);
+
+	void Remove(int32 Handle);
+
+	FAnimatedTexturePlayback& GetPlayback(int32 Handle) { return Playbacks[Handle]; }
+
+	/** Seconds without being rendered before a texture stops playing, r.AnimatedTexture.VisibilityTimeout */
+	static float GetVisibilityTimeout();
+
+#if WITH_EDITOR
+	/** True if the platform sets r.AnimatedTexture.MemoryBudgetMB, the cook then keeps the GIF file to decode evicted frames again */
+	static bool HasMemoryBudget(const ITargetPlatform* TargetPlatform);
+#endif // WITH_EDITOR
+
+	/** Update interval of a texture with zero significance, r.AnimatedTexture.LowSignificanceInterval */
+	static float GetLowSignificanceInterval();
+
+	//~ Begin FTickableObjectRenderThread Interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override
+	{
+		return Playbacks.Num() > 0;
+	}
+	virtual TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FAnimatedTextureManager, STATGROUP_AnimatedTexture);
+	}
+	//~ End FTickableObjectRenderThread Interface.
+
+private:
+	/** Evict the decoded data of the least recently rendered textures until it fits the budget */
+	void EnforceMemoryBudget();
+
+	/** Memory counters of STATGROUP_AnimatedTexture */
+	void UpdateMemoryStats();
+
+	/** Free the canvas and the texture of the ones not rendered for r.AnimatedTexture.IdleReleaseTimeout */
+	void ReleaseIdleTextures();
+
+	/** Decoded data that can be evicted: the canvas of a resource, or the frame set shared by a texture and its players */
+	struct FDecodedData
+	{
+		double LastRenderTime;
+		SIZE_T Size;
+		FAnimatedTextureResource* Resource;	// nullptr for a frame set
+		UAnimatedTexture2D* Owner;
+		FAnimatedTextureFrameCache* FrameCache;
+		bool bInUse;	// canvas of a texture still ticking, evicting it would only rebuild it right away
+	};
+
+private:
+	TArray<FAnimatedTexturePlayback> Playbacks;
+	TArray<int32> DuePlaybacks;	// playbacks whose frame window was left this tick
+
+	TArray<FDecodedData> DecodedData;
+	float TimeSinceBudgetCheck;
+};
@@ -0,0 +1,117 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTextureMipChain.h"
+#include "BCEncoder.h"
+
+/** Average 2x2 blocks of Src into Rect of Dest, the last row or column of an odd sized level is repeated */
+static void DownsampleRect(const FColor* Src, uint32 SrcWidth, uint32 SrcHeight, FColor* Dest, uint32 DestWidth, const FIntRect& Rect)
+{
+	for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+	{
+		const FColor* Row0 = Src + SrcWidth * FMath::Min<uint32>(Y * 2, SrcHeight - 1);
+		const FColor* Row1 = Src + SrcWidth * FMath::Min<uint32>(Y * 2 + 1, SrcHeight - 1);
+		FColor* DestRow = Dest + DestWidth * Y;
+
+		for (int32 X = Rect.Min.X; X < Rect.Max.X; X++)
+		{
+			const uint32 X0 = FMath::Min<uint32>(X * 2, SrcWidth - 1);
+			const uint32 X1 = FMath::Min<uint32>(X * 2 + 1, SrcWidth - 1);
+			const FColor& A = Row0[X0];
+			const FColor& B = Row0[X1];
+			const FColor& C = Row1[X0];
+			const FColor& D = Row1[X1];
+
+			FColor& Out = DestRow[X];
+			Out.B = (uint8)((A.B + B.B + C.B + D.B + 2) >> 2);
+			Out.G = (uint8)((A.G + B.G + C.G + D.G + 2) >> 2);
+			Out.R = (uint8)((A.R + B.R + C.R + D.R + 2) >> 2);
+			Out.A = (uint8)((A.A + B.A + C.A + D.A + 2) >> 2);
+		}// end of for
+	}// end of for
+}
+
+int32 FAnimatedTextureMipChain::CalcNumMips(uint32 Width, uint32 Height)
+{
+	const uint32 Size = FMath::Max(Width, Height);
+	return Size > 0 ? FMath::FloorLog2(Size) + 1 : 1;
+}
+
+SIZE_T FAnimatedTextureMipChain::CalcTextureSize(uint32 Width, uint32 Height, int32 NumMips, EPixelFormat Format)
+{
+	const bool bCompressed = Format == PF_DXT1 || Format == PF_DXT5;
+
+	SIZE_T Size = 0;
+	for (int32 Mip = 0; Mip < NumMips; Mip++)
+	{
+		const uint32 MipWidth = FMath::Max(Width >> Mip, 1u);
+		const uint32 MipHeight = FMath::Max(Height >> Mip, 1u);
+		Size += bCompressed ? GetBCImageSize(MipWidth, MipHeight, Format) : (SIZE_T)MipWidth * MipHeight * sizeof(FColor);
+	}// end of for
+	return Size;
+}
+
+void FAnimatedTextureMipChain::Init(uint32 InWidth, uint32 InHeight, int32 InNumMips)
+{
+	Width = InWidth;
+	Height = InHeight;
+	NumMips = FMath::Clamp(InNumMips, 1, CalcNumMips(Width, Height));
+
+	LevelOffsets.SetNumUninitialized(NumMips);
+	uint32 Offset = 0;
+	for (int32 Mip = 0; Mip < NumMips; Mip++)
+	{
+		LevelOffsets[Mip] = Offset;
+		if (Mip > 0)
+			Offset += GetLevelWidth(Mip) * GetLevelHeight(Mip);
+	}// end of for
+
+	DirtyRects.SetNum(NumMips);
+	Empty();
+}
+
+void FAnimatedTextureMipChain::Empty()
+{
+	Levels.Empty();
+	for (FIntRect& Rect : DirtyRects)
+		Rect = FIntRect();
+}
+
+void FAnimatedTextureMipChain::Update(const FColor* Canvas, const FIntRect& DirtyRect)
+{
+	if (NumMips < 2)
+		return;
+
+	// levels freed or never filtered are rebuilt entirely
+	FIntRect Rect = DirtyRect;
+	if (Levels.Num() == 0)
+	{
+		Levels.SetNumUninitialized(LevelOffsets.Last() + GetLevelWidth(NumMips - 1) * GetLevelHeight(NumMips - 1));
+		Rect = FIntRect(0, 0, Width, Height);
+	}
+	DirtyRects[0] = Rect;
+
+	const FColor* Src = Canvas;
+	uint32 SrcWidth = Width;
+	uint32 SrcHeight = Height;
+	for (int32 Mip = 1; Mip < NumMips; Mip++)
+	{
+		const uint32 LevelWidth = GetLevelWidth(Mip);
+		const uint32 LevelHeight = GetLevelHeight(Mip);
+
+		// pixels of this level reading any changed pixel of the one above
+		if (Rect.Area() > 0)
+		{
+			Rect.Min = Rect.Min / 2;
+			Rect.Max = FIntPoint(FMath::Min<int32>((Rect.Max.X + 1) / 2, LevelWidth), FMath::Min<int32>((Rect.Max.Y + 1) / 2, LevelHeight));
+		}
+		DirtyRects[Mip] = Rect;
+
+		FColor* Dest = Levels.GetData() + LevelOffsets[Mip];
+		if (Rect.Area() > 0)
+			DownsampleRect(Src, SrcWidth, SrcHeight, Dest, LevelWidth, Rect);
+
+		Src = Dest;
+		SrcWidth = LevelWidth;
+		SrcHeight = LevelHeight;
+	}// end of for
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"	// Core
+
+/**
+ * Box filtered mips of a BGRA canvas, kept on the CPU so each update only filters again
+ * the footprint of the canvas dirty rect in every lower level.
+ * Level 0 is the canvas itself, the chain holds levels 1 to NumMips-1.
+ */
+class FAnimatedTextureMipChain
+{
+public:
+	/** Levels of a full chain down to 1x1 */
+	static int32 CalcNumMips(uint32 Width, uint32 Height);
+
+	/** GPU memory of a texture with NumMips levels, BGRA or block compressed, see BCEncoder.h */
+	static SIZE_T CalcTextureSize(uint32 Width, uint32 Height, int32 NumMips, EPixelFormat Format = PF_B8G8R8A8);
+
+	/** Chain of a Width x Height canvas, the levels are allocated by the first Update */
+	void Init(uint32 InWidth, uint32 InHeight, int32 InNumMips);
+
+	/** Free the levels, the next Update filters them all again */
+	void Empty();
+
+	/** Filter the area of the lower levels covering DirtyRect of the canvas */
+	void Update(const FColor* Canvas, const FIntRect& DirtyRect);
+
+	int32 GetNumMips() const { return NumMips; }
+
+	/** Pixels of level Mip, 1 <= Mip < NumMips, rows are GetLevelWidth(Mip) pixels */
+	const FColor* GetLevel(int32 Mip) const { return Levels.GetData() + LevelOffsets[Mip]; }
+
+	uint32 GetLevelWidth(int32 Mip) const { return FMath::Max(Width >> Mip, 1u); }
+	uint32 GetLevelHeight(int32 Mip) const { return FMath::Max(Height >> Mip, 1u); }
+
+	/** Area of level Mip changed by the last Update */
+	const FIntRect& GetLevelDirtyRect(int32 Mip) const { return DirtyRects[Mip]; }
+
+	/** CPU memory of the levels */
+	SIZE_T GetAllocatedSize() const { return Levels.GetAllocatedSize(); }
+
+private:
+	uint32 Width = 0;
+	uint32 Height = 0;
+	int32 NumMips = 1;
+
+	TArray<FColor> Levels;	// levels 1 to NumMips-1 one after the other
+	TArray<uint32> LevelOffsets;	// first pixel of each level in Levels, NumMips entries
+	TArray<FIntRect> DirtyRects;	// NumMips entries, [0] is the canvas rect
+};
@@ -1,13 +1,32 @@
 // Copyright 2019 Neil Fang. All Rights Reserved.
 
 #include "AnimatedTextureModule.h"
+#include "AnimatedTextureKernels.h"
+#include "AnimatedTextureStats.h"
 
 DEFINE_LOG_CATEGORY(LogAnimTexture);
+
+DEFINE_STAT(STAT_AnimTexParse);
+DEFINE_STAT(STAT_AnimTexDecodeFrame);
+DEFINE_STAT(STAT_AnimTexComposite);
+DEFINE_STAT(STAT_AnimTexDispose);
+DEFINE_STAT(STAT_AnimTexUpload);
+DEFINE_STAT(STAT_AnimTexActive);
+DEFINE_STAT(STAT_AnimTexTicking);
+DEFINE_STAT(STAT_AnimTexUpdated);
+DEFINE_STAT(STAT_AnimTexUploadBytes);
+DEFINE_STAT(STAT_AnimTexFrameDataMemory);
+DEFINE_STAT(STAT_AnimTexPaletteMemory);
+DEFINE_STAT(STAT_AnimTexFramebufferMemory);
+DEFINE_STAT(STAT_AnimTexRHIMemory);
+
+CSV_DEFINE_CATEGORY(AnimatedTexture, true);
 #define LOCTEXT_NAMESPACE "FAnimatedTextureModule"
 
 void FAnimatedTextureModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	InitAnimatedTextureKernels();
 }
 
 void FAnimatedTextureModule::ShutdownModule()
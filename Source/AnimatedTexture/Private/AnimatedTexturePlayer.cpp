@@ -0,0 +1,193 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTexturePlayer.h"
+#include "AnimatedTexture2D.h"
+#include "AnimatedTextureResource.h"
+
+#include "UObject/Package.h"	// CoreUObject
+#include "RenderingThread.h"	// RenderCore
+
+UAnimatedTexturePlayer::UAnimatedTexturePlayer(const FObjectInitializer& ObjectInitializer /*= FObjectInitializer::Get()*/)
+	:Super(ObjectInitializer)
+{
+}
+
+UAnimatedTexturePlayer* UAnimatedTexturePlayer::CreateAnimatedTexturePlayer(UAnimatedTexture2D* InSource)
+{
+	UAnimatedTexturePlayer* Player = NewObject<UAnimatedTexturePlayer>(GetTransientPackage(), NAME_None, RF_Transient);
+	Player->SetSource(InSource);
+	return Player;
+}
+
+void UAnimatedTexturePlayer::SetSource(UAnimatedTexture2D* NewSource)
+{
+	Source = NewSource;
+	CopySourceSettings();
+	UpdateResource();
+}
+
+void UAnimatedTexturePlayer::CopySourceSettings()
+{
+	if (Source)
+	{
+		SRGB = Source->SRGB;
+		Filter = Source->Filter;
+		LODGroup = Source->LODGroup;
+	}
+}
+
+float UAnimatedTexturePlayer::GetSurfaceWidth() const
+{
+	return Source ? Source->GetSurfaceWidth() : 0.0f;
+}
+
+float UAnimatedTexturePlayer::GetSurfaceHeight() const
+{
+	return Source ? Source->GetSurfaceHeight() : 0.0f;
+}
+
+FTextureResource* UAnimatedTexturePlayer::CreateResource()
+{
+	if (Source == nullptr)
+		return nullptr;
+
+	// frames still parsing in the background are handed over by the source, as it does for its own resource
+	Source->RegisterPlayer(this);
+
+	FAnimatedTexturePlaybackSettings Settings(PlayRate, MaxUpdateRate, bPlaying, bLooping, bAlwaysTickEvenNoSee);
+	return new FAnimatedTextureResource(Source, this, Settings);
+}
+
+uint32 UAnimatedTexturePlayer::CalcTextureMemorySizeEnum(ETextureMipCount Enum) const
+{
+	// pre-uploaded frames belong to the source
+	if (Source == nullptr || Source->UsesPreUploadedFrames())
+		return 4;
+
+	uint32 Width = (uint32)Source->GetSurfaceWidth();
+	uint32 Height = (uint32)Source->GetSurfaceHeight();
+	if (Width == 0 || Height == 0)
+		return 4;
+
+	uint32 Flags = SRGB ? TexCreate_SRGB : 0;
+	uint32 TextureAlign;
+	EPixelFormat Format = Source->HasCompressedFrames() ? Source->GetCompressedFormat() : PF_B8G8R8A8;
+	uint32 Size = (uint32)RHICalcTexture2DPlatformSize(Width, Height, Format, Source->GetCanvasMipCount(), 1, (ETextureCreateFlags)Flags, FRHIResourceCreateInfo(), TextureAlign);
+	return Size * Source->GetTextureBufferCount();
+}
+
+void UAnimatedTexturePlayer::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+	CumulativeResourceSize.AddDedicatedVideoMemoryBytes(CalcTextureMemorySizeEnum(TMC_ResidentMips));
+}
+
+#if WITH_EDITOR
+void UAnimatedTexturePlayer::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	static const FName SourceName = GET_MEMBER_NAME_CHECKED(UAnimatedTexturePlayer, Source);
+	if (PropertyChangedEvent.Property && PropertyChangedEvent.Property->GetFName() == SourceName)
+		CopySourceSettings();
+
+	// recreates the resource with the new properties
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+}
+#endif // WITH_EDITOR
+
+void UAnimatedTexturePlayer::Play()
+{
+	bPlaying = true;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::PlayFromStart()
+{
+	bPlaying = true;
+	UpdatePlaybackSettings();
+	SeekToFrame(0);
+}
+
+void UAnimatedTexturePlayer::Stop()
+{
+	bPlaying = false;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::SeekToFrame(int32 FrameIndex)
+{
+	SeekInternal(FrameIndex, 0.0f);
+}
+
+void UAnimatedTexturePlayer::SeekToTime(float Time)
+{
+	if (Source == nullptr || Source->GetFrameCount() == 0)
+		return;
+
+	float FrameTime = 0.0f;
+	int32 FrameIndex = Source->FindPlaybackFrame(Time, bLooping, FrameTime);
+	SeekInternal(FrameIndex, FrameTime);
+}
+
+void UAnimatedTexturePlayer::SetLooping(bool bNewLooping)
+{
+	bLooping = bNewLooping;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::SetPlayRate(float NewRate)
+{
+	PlayRate = NewRate;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::SetAlwaysTickEvenNoSee(bool bNewAlwaysTick)
+{
+	bAlwaysTickEvenNoSee = bNewAlwaysTick;
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::SetMaxUpdateRate(float NewMaxUpdateRate)
+{
+	MaxUpdateRate = FMath::Max(NewMaxUpdateRate, 0.0f);
+	UpdatePlaybackSettings();
+}
+
+void UAnimatedTexturePlayer::ReportScreenSize(float ScreenSize)
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	ENQUEUE_RENDER_COMMAND(AnimatedTexturePlayerScreenSize)(
+		[AnimResource, ScreenSize](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SetScreenSize(ScreenSize);
+		});
+}
+
+void UAnimatedTexturePlayer::UpdatePlaybackSettings()
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	FAnimatedTexturePlaybackSettings Settings(PlayRate, MaxUpdateRate, bPlaying, bLooping, bAlwaysTickEvenNoSee);
+	ENQUEUE_RENDER_COMMAND(AnimatedTexturePlayerPlayback)(
+		[AnimResource, Settings](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SetPlaybackSettings(Settings);
+		});
+}
+
+void UAnimatedTexturePlayer::SeekInternal(int32 FrameIndex, float FrameTime)
+{
+	FAnimatedTextureResource* AnimResource = static_cast<FAnimatedTextureResource*>(Resource);
+	if (!AnimResource)
+		return;
+
+	ENQUEUE_RENDER_COMMAND(AnimatedTexturePlayerSeek)(
+		[AnimResource, FrameIndex, FrameTime](FRHICommandListImmediate& RHICmdList)
+		{
+			AnimResource->SeekToFrame(FrameIndex, FrameTime);
+		});
+}
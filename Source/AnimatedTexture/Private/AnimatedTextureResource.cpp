@@ -3,18 +3,55 @@
 #include "AnimatedTextureResource.h"
 #include "AnimatedTexture2D.h"
 #include "AnimatedTextureModule.h"
+#include "AnimatedTextureManager.h"
+#include "AnimatedTextureStats.h"
+#include "BCEncoder.h"
 
 #include "DeviceProfiles/DeviceProfile.h"	// Engine
 #include "DeviceProfiles/DeviceProfileManager.h"	// Engine
+#include "HAL/IConsoleManager.h"	// Core
+
+static TAutoConsoleVariable<int32> CVarAnimatedTextureMaxCanvasDownscale(
+	TEXT("r.AnimatedTexture.MaxCanvasDownscale"),
+	3,
+	TEXT("Animated textures drawn smaller than their size, see ReportScreenSize, are composed and uploaded at a reduced resolution:\n")
+	TEXT("up to 1/2^N of the GIF size, 0..3. 0 always composes at full resolution."),
+	ECVF_Default);
+
+/**
+ * Largest canvas scale still at least as large as the screen size,
+ * a smaller canvas is only picked with a margin so a texture drawn near a threshold does not rebuild its canvas again and again
+ */
+static int32 PickCanvasScale(uint32 TextureSize, float ScreenSize, int32 CurrentScale)
+{
+	const int32 MaxScale = FMath::Clamp(CVarAnimatedTextureMaxCanvasDownscale.GetValueOnRenderThread(), 0, (int32)FAnimatedTextureCompositor::MaxScale);
+
+	int32 Scale = 0;
+	while (Scale < MaxScale && (float)FAnimatedTextureCompositor::GetScaledSize(TextureSize, Scale + 1) >= ScreenSize)
+		Scale++;
 
-#include "gif_load/gif_load.h" // from: https://github.com/hidefromkgb/gif_load
+	while (Scale > CurrentScale && (float)FAnimatedTextureCompositor::GetScaledSize(TextureSize, Scale) < ScreenSize * 1.25f)
+		Scale--;
+	return Scale;
+}
 
 
-FAnimatedTextureResource::FAnimatedTextureResource(UAnimatedTexture2D * InOwner) 
-:FTickableObjectRenderThread(false, true),
-Owner(InOwner),
-LastFrame(0)
+FAnimatedTextureResource::FAnimatedTextureResource(UAnimatedTexture2D * InOwner, UTexture* InTexture, const FAnimatedTexturePlaybackSettings& InSettings)
+:Owner(InOwner),
+Texture(InTexture),
+FrameCache(InOwner->GetFrameCache()),
+Compositor(InOwner, InOwner->KeyframeInterval),
+CanvasTextureIndex(0),
+Settings(InSettings),
+Significance(1.0f),
+PlaybackHandle(INDEX_NONE),
+LastUploadBytes(0),
+PlaceholderColor(InOwner->GetBackgroundColor()),
+ActiveTime(0.0),
+bFramesReady(InOwner->GetFrameCount() > 0),
+bIdleReleased(false)
 {
+	Compositor.SetFrameCache(FrameCache);
 }
 
 uint32 FAnimatedTextureResource::GetSizeX() const
@@ -50,14 +87,9 @@ void FAnimatedTextureResource::InitRHI()
 	);
 
 	//-- create FTextureRHIRef FTexture::TextureRHI
-	//uint32 TexCreateFlags = Owner->SRGB ? TexCreate_SRGB : 0;
-	uint32 Flags = Owner->SRGB ? TexCreate_SRGB : 0;
-	uint32 NumMips = 1;
-	uint32 NumSamples = 1;
-
-	FRHIResourceCreateInfo CreateInfo;
-	TextureRHI = RHICreateTexture2D(FMath::Max(GetSizeX(),1u), FMath::Max(GetSizeY(), 1u), (uint8)PF_B8G8R8A8, NumMips, NumSamples, (ETextureCreateFlags)Flags, CreateInfo);
-	TextureRHI->SetName(Owner->GetFName());
+	CreateScaledCanvasTexture();
+	bIdleReleased = false;
+	ActiveTime = FApp::GetCurrentTime();
 
 	//TRefCountPtr<FRHITexture2D> ShaderTexture2D;
 	//TRefCountPtr<FRHITexture2D> RenderableTexture;
@@ -79,68 +111,391 @@ void FAnimatedTextureResource::InitRHI()
 
 
 
-	RHIUpdateTextureReference(Owner->TextureReference.TextureReferenceRHI, TextureRHI);
+	RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
 
 	if(Owner->GlobalHeight > 0 && Owner->GlobalWidth > 0)
 	{
-		DecodeFrameToRHI();
+		// a new texture has none of the frame buffer
+		Compositor.MarkAllDirty();
+
+		if (bFramesReady && Owner->UsesPreUploadedFrames())
+			CreateFrameTextures();
+
+		if (bFramesReady)
+			DecodeFrameToRHI();
+		else
+			ClearTexture(PlaceholderColor);
 	}
 	
 
-	Register();
+	PlaybackHandle = FAnimatedTextureManager::Get().Add(this);
+	RefreshPlayback(true);
 }
 
 void FAnimatedTextureResource::ReleaseRHI()
 {
-	Unregister();
+	if (PlaybackHandle != INDEX_NONE)
+	{
+		FAnimatedTextureManager::Get().Remove(PlaybackHandle);
+		PlaybackHandle = INDEX_NONE;
+	}
 
-	RHIUpdateTextureReference(Owner->TextureReference.TextureReferenceRHI, nullptr);
+	RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, nullptr);
+	ReleaseFrameTextures();
+	CanvasTextures.Empty();
+	CanvasDirtyRects.Empty();
+	CanvasFences.Empty();
+	MipChain.Empty();
 	FTextureResource::ReleaseRHI();
 }
 
-void FAnimatedTextureResource::Tick(float DeltaTime)
+bool FAnimatedTextureResource::WasRecentlyRendered() const
+{
+	float Duration = FApp::GetCurrentTime() - GetLastRenderTime();
+	return Duration < FAnimatedTextureManager::GetVisibilityTimeout();
+}
+
+double FAnimatedTextureResource::GetLastRenderTime() const
+{
+	return Texture->GetLastRenderTimeForStreaming();
+}
+
+SIZE_T FAnimatedTextureResource::GetTextureMemorySize() const
+{
+	// pre-uploaded frames are counted once for all players, see FAnimatedTextureFrameCache::GetFrameTexturesSize
+	if (FrameTextures.Num() > 0 || !TextureRHI)
+		return 0;
+
+	FRHITexture2D* Texture2DRHI = TextureRHI->GetTexture2D();
+	if (!Texture2DRHI)
+		return 0;
+
+	// the textures of the ring are all alike
+	const SIZE_T Size = FAnimatedTextureMipChain::CalcTextureSize(Texture2DRHI->GetSizeX(), Texture2DRHI->GetSizeY(), Texture2DRHI->GetNumMips(), Texture2DRHI->GetFormat());
+	return Size * FMath::Max(CanvasTextures.Num(), 1);
+}
+
+SIZE_T FAnimatedTextureResource::EvictDecodedData()
+{
+	SIZE_T Size = GetDecodedDataSize();
+	Compositor.Empty();
+	MipChain.Empty();
+	return Size;
+}
+
+double FAnimatedTextureResource::GetIdleTime() const
 {
-	float duration = FApp::GetCurrentTime() - Owner->GetLastRenderTimeForStreaming();
-	bool bShouldTick = Owner->bAlwaysTickEvenNoSee || duration < 2.5f;
-	if(bShouldTick && Owner && Owner->IsPlaying() && Owner->GlobalHeight >0 && Owner->GlobalWidth > 0)
+	return FApp::GetCurrentTime() - FMath::Max(GetLastRenderTime(), ActiveTime);
+}
+
+bool FAnimatedTextureResource::ReleaseIdleData()
+{
+	check(IsInRenderingThread());
+
+	if (bIdleReleased || !bFramesReady || !TextureRHI)
+		return false;
+
+	Compositor.Empty();
+	MipChain.Empty();
+
+	// shared frame textures go with the last player holding them
+	ReleaseFrameTextures();
+	CanvasTextures.Empty();
+	CanvasDirtyRects.Empty();
+	CanvasFences.Empty();
+
+	// materials keep sampling the texture reference, which is what tells us to restore it
+	TextureRHI = CreateCanvasTexture(1, 1, 1);
+	ClearTexture(PlaceholderColor);
+	RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
+	LastUploadBytes = 0;
+
+	bIdleReleased = true;
+	if (PlaybackHandle != INDEX_NONE)
+		FAnimatedTextureManager::Get().GetPlayback(PlaybackHandle).bIdleReleased = true;
+
+	UE_LOG(LogAnimTexture, Verbose, TEXT("Released idle animated texture %s"), *Texture->GetName());
+	return true;
+}
+
+void FAnimatedTextureResource::RestoreIdleData()
+{
+	check(IsInRenderingThread());
+
+	if (!bIdleReleased)
+		return;
+
+	bIdleReleased = false;
+	ActiveTime = FApp::GetCurrentTime();
+	if (PlaybackHandle != INDEX_NONE)
+		FAnimatedTextureManager::Get().GetPlayback(PlaybackHandle).bIdleReleased = false;
+
+	// frame textures still shared by another player come back without composing anything,
+	// otherwise the canvas replays from the nearest keyframe
+	if (Owner->UsesPreUploadedFrames())
 	{
-		TickAnim(DeltaTime * Owner->PlayRate);
+		CreateFrameTextures();
+	}
+	else
+	{
+		CreateScaledCanvasTexture();
+		RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
+		if (ComposesFrames())
+		{
+			Compositor.SeekTo(AnimState.CurrentFrame);
+			Compositor.MarkAllDirty();
+		}
 	}
+	DecodeFrameToRHI();
 }
 
 bool FAnimatedTextureResource::TickAnim(float DeltaTime)
 {
-	bool NextFrame = false;
-	float FrameDelay = Owner->GetFrameDelay(AnimState.CurrentFrame);
-	if (FrameDelay == 0.0f)
-		FrameDelay = Owner->DefaultFrameDelay;
-	AnimState.FrameTime += DeltaTime;
+	const float Length = Owner->GetPlaybackLength();
+	if (Length <= 0.0f)
+		return false;
 
-	// skip long duration
-	float Duration = Owner->GetTotalDuration();
-	if (AnimState.FrameTime > Duration)
+	// animation time from the start of frame 0, so hitches do not make playback drift behind
+	float Time = Owner->GetFrameStartTime(AnimState.CurrentFrame) + AnimState.FrameTime + DeltaTime;
+	if (Settings.bLooping)
 	{
-		float N = FMath::TruncToFloat(AnimState.FrameTime / Duration);
-		AnimState.FrameTime -= N * Duration;
+		Time = FMath::Fmod(Time, Length);
+		if (Time < 0.0f)
+			Time += Length;
+	}
+	else
+	{
+		Time = FMath::Clamp(Time, 0.0f, Length);
 	}
 
-	// step to next frame
-	if (AnimState.FrameTime > FrameDelay) {
-		AnimState.CurrentFrame++;
-		AnimState.FrameTime -= FrameDelay;
-		NextFrame = true;
+	float FrameTime = 0.0f;
+	int32 TargetFrame = Owner->FindFrameAtTime(Time, FrameTime);
+	AnimState.FrameTime = FrameTime;
 
-		// loop
-		int NumFrame = Owner->GetFrameCount();
-		if (AnimState.CurrentFrame >= NumFrame)
-			AnimState.CurrentFrame = Owner->bLooping ? 0 : NumFrame - 1;
+	if (TargetFrame == AnimState.CurrentFrame)
+		return false;
+
+	// frames skipped over only update the canvas, the texture is written once
+	if (ComposesFrames())
+		Compositor.AdvanceTo(TargetFrame);
+	AnimState.CurrentFrame = TargetFrame;
+	DecodeFrameToRHI();
+
+	return true;
+}
+
+void FAnimatedTextureResource::OnFramesReady(const FAnimatedTextureFrameCachePtr& InFrameCache)
+{
+	check(IsInRenderingThread());
+
+	if (bFramesReady || Owner->GetFrameCount() == 0)
+		return;
+
+	bFramesReady = true;
+	FrameCache = InFrameCache;
+	Compositor.SetFrameCache(FrameCache);
+	AnimState = FAnmatedTextureState();
+	Compositor.Reset();
+
+	if (TextureRHI)
+	{
+		if (Owner->UsesPreUploadedFrames())
+			CreateFrameTextures();
+		DecodeFrameToRHI();
 	}
-	if(NextFrame)
+	RefreshPlayback(true);
+}
+
+void FAnimatedTextureResource::SeekToFrame(int32 FrameIndex, float FrameTime)
+{
+	check(IsInRenderingThread());
+
+	int32 NumFrame = Owner->GetFrameCount();
+	if (!bFramesReady || NumFrame == 0)
+		return;
+
+	AnimState.CurrentFrame = FMath::Clamp(FrameIndex, 0, NumFrame - 1);
+	AnimState.FrameTime = FrameTime;
+
+	if (bIdleReleased)
 	{
+		RestoreIdleData();
+		RefreshPlayback(true);
+		return;
+	}
+
+	if (ComposesFrames())
+		Compositor.SeekTo(AnimState.CurrentFrame);
+	if (TextureRHI)
 		DecodeFrameToRHI();
+	RefreshPlayback(true);
+}
+
+void FAnimatedTextureResource::SetPlaybackSettings(const FAnimatedTexturePlaybackSettings& InSettings)
+{
+	check(IsInRenderingThread());
+
+	Settings = InSettings;
+	RefreshPlayback(false);
+}
+
+void FAnimatedTextureResource::SetScreenSize(float ScreenSize)
+{
+	check(IsInRenderingThread());
+
+	uint32 TextureSize = FMath::Max(Owner->GlobalWidth, Owner->GlobalHeight);
+	Significance = TextureSize > 0 ? FMath::Clamp(ScreenSize / TextureSize, 0.0f, 1.0f) : 1.0f;
+
+	// pre-uploaded or cooked frames cost nothing to compose, and no screen size says nothing about the resolution needed
+	if (TextureSize > 0 && ScreenSize > 0.0f && !Owner->UsesPreUploadedFrames() && !Owner->HasCompressedFrames())
+		SetCanvasScale(PickCanvasScale(TextureSize, ScreenSize, Compositor.GetScale()));
+
+	RefreshPlayback(false);
+}
+
+void FAnimatedTextureResource::SetCanvasScale(int32 Scale)
+{
+	if (Scale == Compositor.GetScale())
+		return;
+
+	Compositor.SetScale(Scale);
+	if (!TextureRHI || bIdleReleased)
+		return;
+
+	// the current frame is composed again at the new size
+	CreateScaledCanvasTexture();
+	RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
+	if (bFramesReady)
+	{
+		Compositor.SeekTo(AnimState.CurrentFrame);
+		DecodeFrameToRHI();
+	}
+	else
+	{
+		ClearTexture(PlaceholderColor);
 	}
+}
+
+void FAnimatedTextureResource::GetFrameWindow(float& OutMin, float& OutMax) const
+{
+	const int32 NumFrame = Owner->GetFrameCount();
+	const int32 CurrentFrame = AnimState.CurrentFrame;
+	const float FrameDelay = Owner->GetFrameStartTime(CurrentFrame + 1) - Owner->GetFrameStartTime(CurrentFrame);
 
-	return NextFrame;
+	// a non-looping animation never leaves its first or last frame in the outward direction
+	OutMin = (!Settings.bLooping && CurrentFrame == 0) ? -FLT_MAX : -AnimState.FrameTime;
+	OutMax = (!Settings.bLooping && CurrentFrame == NumFrame - 1) ? FLT_MAX : FrameDelay - AnimState.FrameTime;
+}
+
+void FAnimatedTextureResource::RefreshPlayback(bool bRestartClock)
+{
+	if (PlaybackHandle == INDEX_NONE)
+		return;
+
+	FAnimatedTexturePlayback& Playback = FAnimatedTextureManager::Get().GetPlayback(PlaybackHandle);
+	if (bRestartClock)
+		Playback.Elapsed = 0.0f;
+	Playback.bAlwaysTickEvenNoSee = Settings.bAlwaysTickEvenNoSee;
+	Playback.Significance = Significance;
+
+	// the slower of the texture's own cap and the one from its screen size
+	float MinUpdateInterval = Settings.MaxUpdateRate > 0.0f ? 1.0f / Settings.MaxUpdateRate : 0.0f;
+	Playback.MinUpdateInterval = FMath::Max(MinUpdateInterval, FAnimatedTextureManager::GetLowSignificanceInterval() * (1.0f - Significance));
+
+	bool bCanPlay = bFramesReady && Owner->GetPlaybackLength() > 0.0f && Owner->GlobalWidth > 0 && Owner->GlobalHeight > 0;
+	if (bCanPlay && Settings.bPlaying)
+	{
+		Playback.PlayRate = Settings.PlayRate;
+		GetFrameWindow(Playback.WindowMin, Playback.WindowMax);
+	}
+	else
+	{
+		Playback.PlayRate = 0.0f;
+		Playback.WindowMin = -FLT_MAX;
+		Playback.WindowMax = FLT_MAX;
+	}
+}
+
+void FAnimatedTextureResource::ClearTexture(FColor Color)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexUpload);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Upload);
+
+	// block compressed textures are only written with cooked frames, they never show the placeholder
+	FTexture2DRHIRef Texture2DRHI = TextureRHI->GetTexture2D();
+	if (!Texture2DRHI || Texture2DRHI->GetFormat() != PF_B8G8R8A8)
+		return;
+
+	// sent like a frame upload: the RHI copies it to the new texture, where a lock could wait on the GPU
+	TArray<FColor> Pixels;
+	Pixels.Init(Color, Texture2DRHI->GetSizeX() * Texture2DRHI->GetSizeY());
+	for (uint32 Mip = 0; Mip < Texture2DRHI->GetNumMips(); Mip++)
+	{
+		const uint32 TexWidth = FMath::Max(Texture2DRHI->GetSizeX() >> Mip, 1u);
+		const uint32 TexHeight = FMath::Max(Texture2DRHI->GetSizeY() >> Mip, 1u);
+		FUpdateTextureRegion2D Region(0, 0, 0, 0, TexWidth, TexHeight);
+		RHIUpdateTexture2D(Texture2DRHI, Mip, Region, TexWidth * sizeof(FColor), (const uint8*)Pixels.GetData());
+	}// end of for
+}
+
+FTexture2DRHIRef FAnimatedTextureResource::CreateCanvasTexture(uint32 Width, uint32 Height, uint32 NumMips, EPixelFormat Format) const
+{
+	uint32 Flags = Texture->SRGB ? TexCreate_SRGB : 0;
+	uint32 NumSamples = 1;
+
+	FRHIResourceCreateInfo CreateInfo;
+	FTexture2DRHIRef Texture2DRHI = RHICreateTexture2D(FMath::Max(Width, 1u), FMath::Max(Height, 1u), (uint8)Format, NumMips, NumSamples, (ETextureCreateFlags)Flags, CreateInfo);
+	Texture2DRHI->SetName(Texture->GetFName());
+	return Texture2DRHI;
+}
+
+void FAnimatedTextureResource::CreateScaledCanvasTexture()
+{
+	const int32 NumBuffers = Owner->GetTextureBufferCount();
+	CanvasTextures.Reset(NumBuffers);
+	CanvasTextureIndex = 0;
+
+	// nothing sampled the new textures yet
+	CanvasFences.Reset();
+	CanvasFences.SetNum(NumBuffers);
+
+	if (Owner->HasCompressedFrames())
+	{
+		for (int32 i = 0; i < NumBuffers; i++)
+			CanvasTextures.Add(CreateCanvasTexture(GetSizeX(), GetSizeY(), Owner->GetCanvasMipCount(), Owner->GetCompressedFormat()));
+	}
+	else
+	{
+		const int32 Scale = Compositor.GetScale();
+		const uint32 Width = FAnimatedTextureCompositor::GetScaledSize(GetSizeX(), Scale);
+		const uint32 Height = FAnimatedTextureCompositor::GetScaledSize(GetSizeY(), Scale);
+
+		MipChain.Init(Width, Height, Owner->GetCanvasMipCount());
+		for (int32 i = 0; i < NumBuffers; i++)
+			CanvasTextures.Add(CreateCanvasTexture(Width, Height, MipChain.GetNumMips()));
+
+		// new textures have none of the canvas
+		CanvasDirtyRects.Init(FIntRect(0, 0, Width, Height), NumBuffers);
+	}
+	TextureRHI = CanvasTextures[0];
+}
+
+void FAnimatedTextureResource::PresentCanvasTexture(int32 Index)
+{
+	if (Index == CanvasTextureIndex)
+		return;
+
+	// frames in flight may still sample the texture swapped out, the fence tells when the GPU is past them
+	FGPUFenceRHIRef& Fence = CanvasFences[CanvasTextureIndex];
+	if (Fence.IsValid())
+		Fence->Clear();
+	else
+		Fence = RHICreateGPUFence(TEXT("AnimatedTextureCanvas"));
+	FRHICommandListExecutor::GetImmediateCommandList().WriteGPUFence(Fence);
+
+	CanvasTextureIndex = Index;
+	TextureRHI = CanvasTextures[Index];
+	RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
 }
 
 int32 FAnimatedTextureResource::GetDefaultMipMapBias() const
@@ -152,7 +507,7 @@ void FAnimatedTextureResource::CreateSamplerStates(float MipMapBias)
 {
 	FSamplerStateInitializerRHI SamplerStateInitializer
 	(
-		(ESamplerFilter)UDeviceProfileManager::Get().GetActiveProfile()->GetTextureLODSettings()->GetSamplerFilter(Owner),
+		(ESamplerFilter)UDeviceProfileManager::Get().GetActiveProfile()->GetTextureLODSettings()->GetSamplerFilter(Texture),
 		Owner->AddressX == TA_Wrap ? AM_Wrap : (Owner->AddressX == TA_Clamp ? AM_Clamp : AM_Mirror),
 		Owner->AddressY == TA_Wrap ? AM_Wrap : (Owner->AddressY == TA_Clamp ? AM_Clamp : AM_Mirror),
 		AM_Wrap,
@@ -162,7 +517,7 @@ void FAnimatedTextureResource::CreateSamplerStates(float MipMapBias)
 
 	FSamplerStateInitializerRHI DeferredPassSamplerStateInitializer
 	(
-		(ESamplerFilter)UDeviceProfileManager::Get().GetActiveProfile()->GetTextureLODSettings()->GetSamplerFilter(Owner),
+		(ESamplerFilter)UDeviceProfileManager::Get().GetActiveProfile()->GetTextureLODSettings()->GetSamplerFilter(Texture),
 		Owner->AddressX == TA_Wrap ? AM_Wrap : (Owner->AddressX == TA_Clamp ? AM_Clamp : AM_Mirror),
 		Owner->AddressY == TA_Wrap ? AM_Wrap : (Owner->AddressY == TA_Clamp ? AM_Clamp : AM_Mirror),
 		AM_Wrap,
@@ -176,155 +531,234 @@ void FAnimatedTextureResource::CreateSamplerStates(float MipMapBias)
 }
 
 
-void FAnimatedTextureResource::DecodeFrameToRHI()
+void FAnimatedTextureResource::CreateFrameTextures()
 {
-	if (FrameBuffer[0].Num() != Owner->GlobalHeight * Owner->GlobalWidth) {
-		LastFrame = 0;
+	const uint32 Width = Owner->GlobalWidth;
+	const uint32 Height = Owner->GlobalHeight;
+	const int32 NumFrame = Owner->GetFrameCount();
+	const bool bSRGB = Texture->SRGB;
+	uint32 Flags = bSRGB ? TexCreate_SRGB : 0;
+
+	const bool bCompressed = Owner->HasCompressedFrames();
+	const uint32 NumMips = bCompressed ? Owner->GetCanvasMipCount() : MipChain.GetNumMips();
+
+	// playback switches between the frame textures, the canvas ring is not written
+	ReleaseFrameTextures();
+	CanvasTextures.Empty();
+	CanvasDirtyRects.Empty();
+	CanvasFences.Empty();
+
+	// players of the same texture share the frame textures
+	if (FrameCache.IsValid() && FrameCache->FrameTextures.Num() == NumFrame && FrameCache->bFrameTexturesSRGB == bSRGB
+		&& FrameCache->FrameTextures[0]->GetNumMips() == NumMips)
+	{
+		FrameTextures = FrameCache->FrameTextures;
+		FrameCache->FrameTextureUsers++;
+		return;
+	}
+
+	FrameTextures.Reset(NumFrame);
+	if (bCompressed)
+	{
+		// cooked frames are uploaded as they are
+		for (int32 i = 0; i < NumFrame; i++)
+		{
+			FTexture2DRHIRef FrameTexture = CreateCanvasTexture(Width, Height, NumMips, Owner->GetCompressedFormat());
+			UploadCompressedFrame(FrameTexture, i);
+			FrameTextures.Add(FrameTexture);
+		}// end of for
+	}
+	else
+	{
+		// frame textures are shared, so they are always composed at full size
+		Compositor.SetScale(0);
+		Compositor.Reset();
+		for (int32 i = 0; i < NumFrame; i++)
+		{
+			FRHIResourceCreateInfo CreateInfo;
+			FTexture2DRHIRef FrameTexture = RHICreateTexture2D(Width, Height, (uint8)PF_B8G8R8A8, NumMips, 1, (ETextureCreateFlags)Flags, CreateInfo);
+			FrameTexture->SetName(Texture->GetFName());
+
+			// a frame that fails to decode shows the canvas it would be drawn on
+			Compositor.ComposeFrame(i);
+			Compositor.ConsumeDirtyRect();
+			UploadRect(FrameTexture, FIntRect(0, 0, Width, Height));
+			Compositor.DisposeFrame();
+
+			FrameTextures.Add(FrameTexture);
+		}// end of for
+	}
 
-		FColor BGColor(0L);
-		const FGIFFrame& GIFFrame = Owner->Frames[0];
-		if (!Owner->SupportsTransparency)
-			BGColor = GIFFrame.Palette[Owner->Background];
+	// playback only switches textures from now on
+	Compositor.Empty();
+	MipChain.Empty();
 
-		for (int i = 0; i < 2; i++)
-			FrameBuffer[i].Init(BGColor, Owner->GlobalHeight * Owner->GlobalWidth);
+	// resources still holding textures that did not match keep counting as users until they let go
+	if (FrameCache.IsValid())
+	{
+		FrameCache->FrameTextures = FrameTextures;
+		FrameCache->FrameTextureUsers++;
+		FrameCache->bFrameTexturesSRGB = bSRGB;
 	}
+}
 
-	bool FirstFrame = AnimState.CurrentFrame == 0;
-	FTexture2DRHIRef Texture2DRHI = TextureRHI->GetTexture2D();
-	if (!Texture2DRHI)
+void FAnimatedTextureResource::ReleaseFrameTextures()
+{
+	if (FrameTextures.Num() == 0)
 		return;
 
-	FGIFFrame& GIFFrame = Owner->Frames[AnimState.CurrentFrame];
-	uint32& InLastFrame = LastFrame;
-	bool bSupportsTransparency = Owner->SupportsTransparency;
+	FrameTextures.Empty();
+	if (FrameCache.IsValid() && --FrameCache->FrameTextureUsers <= 0)
+	{
+		FrameCache->FrameTextureUsers = 0;
+		FrameCache->FrameTextures.Empty();
+	}
+}
 
-	FColor* PICT = FrameBuffer[InLastFrame].GetData();
-	uint32 InBackground = Owner->Background;
+void FAnimatedTextureResource::DecodeFrameToRHI()
+{
+	if (FrameTextures.Num() > 0)
+	{
+		TextureRHI = FrameTextures[AnimState.CurrentFrame];
+		RHIUpdateTextureReference(Texture->TextureReference.TextureReferenceRHI, TextureRHI);
+		LastUploadBytes = 0;
+		return;
+	}
 
-	TArray<FColor>& Pal = GIFFrame.Palette;
+	// with a ring, the oldest texture is written once the GPU is done sampling it, so the write never waits on it.
+	// When frames come faster than the GPU renders them, the texture sampled now is written in place as with a single one
+	const int32 NumBuffers = CanvasTextures.Num();
+	int32 WriteIndex = CanvasTextureIndex;
+	if (NumBuffers > 1)
+	{
+		const int32 NextIndex = (CanvasTextureIndex + 1) % NumBuffers;
+		const FGPUFenceRHIRef& Fence = CanvasFences[NextIndex];
+		if (!Fence.IsValid() || Fence->Poll())
+			WriteIndex = NextIndex;
+	}
+	FTexture2DRHIRef Texture2DRHI = NumBuffers > 0 ? CanvasTextures[WriteIndex] : TextureRHI->GetTexture2D();
+	if (!Texture2DRHI)
+		return;
 
-	uint32 TexWidth = Texture2DRHI->GetSizeX();
-	uint32 TexHeight = Texture2DRHI->GetSizeY();
+	if (Owner->HasCompressedFrames())
+	{
+		UploadCompressedFrame(Texture2DRHI, AnimState.CurrentFrame);
+		if (NumBuffers > 1)
+			PresentCanvasTexture(WriteIndex);
+		return;
+	}
 
-	//-- decode to frame buffer
-	uint32 DDest = TexWidth * GIFFrame.OffsetY + GIFFrame.OffsetX;
-	uint32 Src = 0;
-	uint32 Iter = GIFFrame.Interlacing ? 0 : 4;
-	uint32 Fin = !Iter ? 4 : 5;
+	if (!Compositor.ComposeFrame(AnimState.CurrentFrame))
+		return;
 
-	for (; Iter < Fin; Iter++) // interlacing support
+	//-- write texture, only the area changed since the last upload
+	const FIntRect DirtyRect = Compositor.ConsumeDirtyRect();
+	if (NumBuffers > 1)
 	{
-		uint32 YOffset = 16U >> ((Iter > 1) ? Iter : 1);
-
-		for (uint32 Y = (8 >> Iter) & 7; Y < GIFFrame.Height; Y += YOffset)
+		// a texture of the ring missed every change made since it was last written,
+		// nothing changed and nothing missed by the texture sampled means it already shows this canvas
+		if (DirtyRect.Area() > 0 || CanvasDirtyRects[CanvasTextureIndex].Area() > 0)
 		{
-			for (uint32 X = 0; X < GIFFrame.Width; X++)
+			for (FIntRect& Rect : CanvasDirtyRects)
 			{
-				uint32 TexIndex = TexWidth * Y + X + DDest;
-				uint8 ColorIndex = GIFFrame.PixelIndices[Src];
-
-				if (ColorIndex != GIFFrame.TransparentIndex)
-					PICT[TexIndex] = Pal[ColorIndex];
-				else
-				{
-					int a = 0;
-					a++;
-				}
-
-				Src++;
-			}// end of for(x)
-		}// end of for(y)
-	}// end of for(iter)
-
-	//-- write texture
-	uint32 DestPitch = 0;
-	FColor* SrcBuffer = PICT;
-	FColor* DestBuffer = (FColor*)RHILockTexture2D(Texture2DRHI, 0, RLM_WriteOnly, DestPitch, false);
-	if (DestBuffer)
-	{
-		uint32 MaxRow = TexHeight;
-		int ColorSize = sizeof(FColor);
-
-		//UE_LOG(LogTemp, Log, TEXT("%d"), ssss);
+				if (Rect.Area() <= 0)
+					Rect = DirtyRect;
+				else if (DirtyRect.Area() > 0)
+					Rect.Union(DirtyRect);
+			}// end of for
 
-		if (DestPitch == TexWidth * ColorSize)
-		{
-			FMemory::Memcpy(DestBuffer, SrcBuffer, DestPitch * MaxRow);
+			UploadRect(Texture2DRHI, CanvasDirtyRects[WriteIndex]);
+			CanvasDirtyRects[WriteIndex] = FIntRect();
+			PresentCanvasTexture(WriteIndex);
 		}
 		else
 		{
-			// copy row by row
-			uint32 SrcPitch = TexWidth * ColorSize;
-			uint32 Pitch = FMath::Min(DestPitch, SrcPitch);
-			for (uint32 y = 0; y < MaxRow; y++)
-			{
-				FMemory::Memcpy(DestBuffer, SrcBuffer, Pitch);
-				DestBuffer += DestPitch / ColorSize;
-				SrcBuffer += SrcPitch / ColorSize;
-			}// end of for
-		}// end of else
-
-		RHIUnlockTexture2D(Texture2DRHI, 0, false);
-	}// end of if
+			LastUploadBytes = 0;
+		}
+	}
 	else
 	{
-		UE_LOG(LogAnimTexture, Warning, TEXT("Unable to lock texture for write"));
-	}// end of else
+		UploadRect(Texture2DRHI, DirtyRect);
+	}
 
 	//-- frame blending
-	EGIF_Mode Mode = (EGIF_Mode)GIFFrame.Mode;
-
-	if (Mode == GIF_PREV && FirstFrame)	// loop restart
-		Mode = GIF_BKGD;
+	Compositor.DisposeFrame();
+}
 
-	switch (Mode)
-	{
-	case GIF_NONE:
-	case GIF_CURR:
-		break;
-	case GIF_BKGD:	// restore background
-	{
-		FColor BGColor(0L);
+void FAnimatedTextureResource::UploadRect(FTexture2DRHIRef Texture2DRHI, const FIntRect& Rect)
+{
+	LastUploadBytes = 0;
+	if (Rect.Area() <= 0)
+		return;
 
-		if (bSupportsTransparency)
-		{
-			if (GIFFrame.TransparentIndex == -1)
-				BGColor = GIFFrame.Palette[InBackground];
-			else
-				BGColor = GIFFrame.Palette[GIFFrame.TransparentIndex];
-			BGColor.A = 0;
-		}
-		else
-		{
-			BGColor = GIFFrame.Palette[InBackground];
-		}
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexUpload);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Upload);
 
-		uint32 BGWidth = GIFFrame.Width;
-		uint32 BGHeight = GIFFrame.Height;
-		uint32 XDest = DDest;
+	const uint32 CanvasWidth = Compositor.GetWidth();
+	const uint32 SrcPitch = CanvasWidth * sizeof(FColor);
+	const FColor* SrcData = Compositor.GetCanvas() + CanvasWidth * Rect.Min.Y + Rect.Min.X;
 
-		if (FirstFrame)
-		{
-			BGWidth = TexWidth;
-			BGHeight = TexHeight;
-			XDest = 0;
-		}
+	// RHIs ignore the source offset of the region, SrcData points at its first pixel instead
+	FUpdateTextureRegion2D Region(Rect.Min.X, Rect.Min.Y, 0, 0, Rect.Width(), Rect.Height());
+	RHIUpdateTexture2D(Texture2DRHI, 0, Region, SrcPitch, (const uint8*)SrcData);
+	LastUploadBytes = Rect.Area() * sizeof(FColor);
 
-		for (uint32 Y = 0; Y < BGHeight; Y++)
+	//-- lower mips, only the footprint of Rect is filtered and written
+	const int32 NumMips = FMath::Min<int32>(Texture2DRHI->GetNumMips(), MipChain.GetNumMips());
+	if (NumMips > 1)
+	{
+		MipChain.Update(Compositor.GetCanvas(), Rect);
+		for (int32 Mip = 1; Mip < NumMips; Mip++)
 		{
-			for (uint32 X = 0; X < BGWidth; X++)
-			{
-				PICT[TexWidth * Y + X + XDest] = BGColor;
-			}// end of for(x)
-		}// end of for(y)
+			const FIntRect& MipRect = MipChain.GetLevelDirtyRect(Mip);
+			if (MipRect.Area() <= 0)
+				break;
+
+			const uint32 MipWidth = MipChain.GetLevelWidth(Mip);
+			const FColor* MipData = MipChain.GetLevel(Mip) + MipWidth * MipRect.Min.Y + MipRect.Min.X;
+			FUpdateTextureRegion2D MipRegion(MipRect.Min.X, MipRect.Min.Y, 0, 0, MipRect.Width(), MipRect.Height());
+			RHIUpdateTexture2D(Texture2DRHI, Mip, MipRegion, MipWidth * sizeof(FColor), (const uint8*)MipData);
+			LastUploadBytes += MipRect.Area() * sizeof(FColor);
+		}// end of for
 	}
-	break;
-	case GIF_PREV:	// restore prevous frame
-		InLastFrame = (InLastFrame + 1) % 2;
-		break;
-	default:
-		UE_LOG(LogAnimTexture, Warning, TEXT("Unknown GIF Mode"));
-		break;
-	}//end of switch
+
+	INC_DWORD_STAT_BY(STAT_AnimTexUploadBytes, LastUploadBytes);
+	CSV_CUSTOM_STAT(AnimatedTexture, UploadBytes, (int32)LastUploadBytes, ECsvCustomStatOp::Accumulate);
+}
+
+void FAnimatedTextureResource::UploadCompressedFrame(FTexture2DRHIRef Texture2DRHI, int32 FrameIndex)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexUpload);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Upload);
+
+	// the idle placeholder is not block compressed
+	const EPixelFormat Format = Owner->GetCompressedFormat();
+	if (Texture2DRHI->GetFormat() != Format)
+		return;
+
+	const uint32 BlockBytes = GetBCBlockBytes(Format);
+	const uint8* Blocks = Owner->GetCompressedFrame(FrameIndex);
+
+	// the cooked frame holds every mip, whole levels are written so their blocks need no alignment
+	LastUploadBytes = 0;
+	const int32 NumMips = FMath::Min<int32>(Texture2DRHI->GetNumMips(), Owner->GetCanvasMipCount());
+	for (int32 Mip = 0; Mip < NumMips; Mip++)
+	{
+		const uint32 MipWidth = FMath::Max(Texture2DRHI->GetSizeX() >> Mip, 1u);
+		const uint32 MipHeight = FMath::Max(Texture2DRHI->GetSizeY() >> Mip, 1u);
+		const uint32 MipSize = GetBCImageSize(MipWidth, MipHeight, Format);
+
+		FUpdateTextureRegion2D Region(0, 0, 0, 0, MipWidth, MipHeight);
+		RHIUpdateTexture2D(Texture2DRHI, Mip, Region, ((MipWidth + 3) / 4) * BlockBytes, Blocks);
+		Blocks += MipSize;
+		LastUploadBytes += MipSize;
+	}// end of for
+
+	INC_DWORD_STAT_BY(STAT_AnimTexUploadBytes, LastUploadBytes);
+	CSV_CUSTOM_STAT(AnimatedTexture, UploadBytes, (int32)LastUploadBytes, ECsvCustomStatOp::Accumulate);
+}
+
+bool FAnimatedTextureResource::ComposesFrames() const
+{
+	return FrameTextures.Num() == 0 && !Owner->HasCompressedFrames();
 }
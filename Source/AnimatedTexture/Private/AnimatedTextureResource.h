@@ -14,6 +14,9 @@
 #include "CoreMinimal.h"
 #include "TextureResource.h"	// Engine
 
+#include "AnimatedTextureCompositor.h"
+#include "AnimatedTextureMipChain.h"
+
 class UAnimatedTexture2D;
 
 struct FAnmatedTextureState {
@@ -23,13 +26,27 @@ struct FAnmatedTextureState {
 	FAnmatedTextureState() :CurrentFrame(0), FrameTime(0) {}
 };
 
+/** Render thread copy of the owner's playback properties */
+struct FAnimatedTexturePlaybackSettings {
+	float PlayRate;
+	float MaxUpdateRate;	// 0: every frame of the GIF is shown
+	bool bPlaying;
+	bool bLooping;
+	bool bAlwaysTickEvenNoSee;
+
+	FAnimatedTexturePlaybackSettings(float InPlayRate, float InMaxUpdateRate, bool bInPlaying, bool bInLooping, bool bInAlwaysTickEvenNoSee)
+		:PlayRate(InPlayRate), MaxUpdateRate(InMaxUpdateRate), bPlaying(bInPlaying), bLooping(bInLooping), bAlwaysTickEvenNoSee(bInAlwaysTickEvenNoSee)
+	{}
+};
+
 /**
- * FTextureResource implementation for animated 2D textures
+ * FTextureResource implementation for animated 2D textures,
+ * plays the frames of a UAnimatedTexture2D into the texture reference of itself or of one of its players
  */
-class FAnimatedTextureResource : public FTextureResource, public FTickableObjectRenderThread
+class FAnimatedTextureResource : public FTextureResource
 {
 public:
-	FAnimatedTextureResource(UAnimatedTexture2D* InOwner);
+	FAnimatedTextureResource(UAnimatedTexture2D* InOwner, UTexture* InTexture, const FAnimatedTexturePlaybackSettings& InSettings);
 
 	//~ Begin FTextureResource Interface.
 	virtual uint32 GetSizeX() const override;
@@ -38,30 +55,124 @@ public:
 	virtual void ReleaseRHI() override;
 	//~ End FTextureResource Interface.
 
-	//~ Begin FTickableObjectRenderThread Interface.
-	virtual void Tick(float DeltaTime) override;
-	virtual bool IsTickable() const override
-	{
-		return true;
-	}
-	virtual TStatId GetStatId() const
-	{
-		RETURN_QUICK_DECLARE_CYCLE_STAT(UAnimatedTexture2D, STATGROUP_Tickables);
-	}
-	//~ End FTickableObjectRenderThread Interface.
-
 	bool TickAnim(float DeltaTime);
 	void DecodeFrameToRHI();
 
+	/** Bytes written to the texture by the last DecodeFrameToRHI */
+	uint32 GetLastUploadBytes() const { return LastUploadBytes; }
+
+	/** Called on the render thread once the owner's frames finished parsing */
+	void OnFramesReady(const FAnimatedTextureFrameCachePtr& InFrameCache);
+
+	/** Jump to a frame, FrameTime is the time already spent on it */
+	void SeekToFrame(int32 FrameIndex, float FrameTime);
+
+	void SetPlaybackSettings(const FAnimatedTexturePlaybackSettings& InSettings);
+
+	/**
+	 * Screen size the texture is drawn at, in pixels along its longer side.
+	 * Textures drawn smaller than their own size update at a reduced rate, see r.AnimatedTexture.LowSignificanceInterval,
+	 * and are composed at 1/2, 1/4 or 1/8 of their size, see r.AnimatedTexture.MaxCanvasDownscale
+	 */
+	void SetScreenSize(float ScreenSize);
+
+	/** Range of animation time from now that keeps showing the current frame */
+	void GetFrameWindow(float& OutMin, float& OutMax) const;
+
+	bool WasRecentlyRendered() const;
+	double GetLastRenderTime() const;
+
+	/** CPU memory of the canvas and its mips, the frames and keyframes are shared and counted separately */
+	SIZE_T GetDecodedDataSize() const { return Compositor.GetAllocatedSize() + MipChain.GetAllocatedSize(); }
+
+	/** GPU memory of the texture written by this resource, shared frame textures are not included */
+	SIZE_T GetTextureMemorySize() const;
+
+	/** Free the canvas and its mips, they are rebuilt from the nearest keyframe when the frame changes next. @return bytes freed */
+	SIZE_T EvictDecodedData();
+
+	/** Seconds since the texture was last rendered, or since its RHI was created when it never was */
+	double GetIdleTime() const;
+
+	/**
+	 * Free the canvas and the full size texture of a texture nobody looks at, a 1x1 texture of the placeholder color stays bound,
+	 * sampling it brings the texture back through RestoreIdleData. @return false when there was nothing to release
+	 */
+	bool ReleaseIdleData();
+
+	/** Rebuild what ReleaseIdleData freed, the texture shows the current frame again */
+	void RestoreIdleData();
+
+	bool IsIdleReleased() const { return bIdleReleased; }
+
+	bool AreFramesReady() const { return bFramesReady; }
+	UAnimatedTexture2D* GetOwner() const { return Owner; }
+	FAnimatedTextureFrameCache* GetFrameCache() const { return FrameCache.Get(); }
+
+	/** Called by FAnimatedTextureManager when the playback record moved */
+	void SetPlaybackHandle(int32 Handle) { PlaybackHandle = Handle; }
+
 
 private:
 	int32 GetDefaultMipMapBias() const;
 
 	void CreateSamplerStates(float MipMapBias);
 
+	void ClearTexture(FColor Color);
+
+	FTexture2DRHIRef CreateCanvasTexture(uint32 Width, uint32 Height, uint32 NumMips, EPixelFormat Format = PF_B8G8R8A8) const;
+
+	/**
+	 * Canvas textures at the compositor scale, with the mips asked for by the owner. Full size in the cooked block format for compressed frames.
+	 * One per UAnimatedTexture2D::GetTextureBufferCount, the first one is bound
+	 */
+	void CreateScaledCanvasTexture();
+
+	/** Sample the canvas texture of the ring at Index from now on, the one swapped out gets a fence */
+	void PresentCanvasTexture(int32 Index);
+
+	/** Compose at 1/2^Scale of the GIF size from now on, the canvas and the texture are rebuilt */
+	void SetCanvasScale(int32 Scale);
+
+	/** Write Rect of the canvas to the texture, and the area of each lower mip it covers */
+	void UploadRect(FTexture2DRHIRef Texture2DRHI, const FIntRect& Rect);
+
+	/** Write every mip of a frame block compressed by the cook, see UAnimatedTexture2D::HasCompressedFrames */
+	void UploadCompressedFrame(FTexture2DRHIRef Texture2DRHI, int32 FrameIndex);
+
+	/** True while frames are drawn by the compositor, not switched between pre-uploaded textures or uploaded as cooked blocks */
+	bool ComposesFrames() const;
+
+	/** Compose every frame into its own texture, see UAnimatedTexture2D::UsesPreUploadedFrames */
+	void CreateFrameTextures();
+
+	/** Let go of the frame textures, shared ones are freed with their last user */
+	void ReleaseFrameTextures();
+
+	/**
+	 * Push the settings and the frame window to the playback record
+	 * @param bRestartClock	AnimState was changed, the time elapsed since the last tick no longer applies
+	 */
+	void RefreshPlayback(bool bRestartClock);
+
 private:
-	UAnimatedTexture2D* Owner;
+	UAnimatedTexture2D* Owner;	// frames
+	UTexture* Texture;	// texture reference, the owner or a UAnimatedTexturePlayer
+	FAnimatedTextureFrameCachePtr FrameCache;
 	FAnmatedTextureState AnimState;
-	TArray<FColor>	FrameBuffer[2];
-	uint32 LastFrame;
+	FAnimatedTextureCompositor Compositor;
+	FAnimatedTextureMipChain MipChain;	// lower mips of the canvas, see UAnimatedTexture2D::bGenerateMips
+	TArray<FTexture2DRHIRef> FrameTextures;	// one per frame when pre-uploaded, TextureRHI is one of them
+	TArray<FTexture2DRHIRef> CanvasTextures;	// ring the frames are written to in turn, TextureRHI is the one written last
+	TArray<FIntRect> CanvasDirtyRects;	// per ring texture, canvas area changed since it was last written
+	TArray<FGPUFenceRHIRef> CanvasFences;	// per ring texture, written when it stopped being sampled, none if it never was
+	int32 CanvasTextureIndex;	// texture of the ring bound to the texture reference
+	FAnimatedTexturePlaybackSettings Settings;
+	float Significance;	// 0..1, screen size relative to the texture size
+	int32 PlaybackHandle;	// record in FAnimatedTextureManager, INDEX_NONE while the RHI is released
+	uint32 LastUploadBytes;
+	FColor PlaceholderColor;
+	double ActiveTime;	// when the RHI was created or restored, idle time starts from there for textures never rendered
+	bool bFramesReady;	// render thread copy, Owner->Frames is not touched before
+	bool bIdleReleased;	// TextureRHI is a 1x1 placeholder, see ReleaseIdleData
 };
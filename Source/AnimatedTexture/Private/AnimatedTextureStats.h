@@ -0,0 +1,42 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"	// Core
+#include "ProfilingDebugging/CsvProfiler.h"	// Core
+
+/**
+ * "stat AnimatedTexture", the CSV profiler gets the same numbers in the AnimatedTexture category
+ */
+DECLARE_STATS_GROUP(TEXT("AnimatedTexture"), STATGROUP_AnimatedTexture, STATCAT_Advanced);
+
+//-- time
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Parse"), STAT_AnimTexParse, STATGROUP_AnimatedTexture, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode Frame"), STAT_AnimTexDecodeFrame, STATGROUP_AnimatedTexture, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Composite"), STAT_AnimTexComposite, STATGROUP_AnimatedTexture, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Dispose"), STAT_AnimTexDispose, STATGROUP_AnimatedTexture, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Lock/Upload"), STAT_AnimTexUpload, STATGROUP_AnimatedTexture, );
+
+//-- per frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active Textures"), STAT_AnimTexActive, STATGROUP_AnimatedTexture, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ticking Textures"), STAT_AnimTexTicking, STATGROUP_AnimatedTexture, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Updated Textures"), STAT_AnimTexUpdated, STATGROUP_AnimatedTexture, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Upload Bytes"), STAT_AnimTexUploadBytes, STATGROUP_AnimatedTexture, );
+
+//-- memory, refreshed about once per second
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Frame Data"), STAT_AnimTexFrameDataMemory, STATGROUP_AnimatedTexture, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Palettes"), STAT_AnimTexPaletteMemory, STATGROUP_AnimatedTexture, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Framebuffers"), STAT_AnimTexFramebufferMemory, STATGROUP_AnimatedTexture, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("RHI Textures"), STAT_AnimTexRHIMemory, STATGROUP_AnimatedTexture, );
+
+CSV_DECLARE_CATEGORY_EXTERN(AnimatedTexture);
@@ -0,0 +1,362 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "BCEncoder.h"
+
+static const int32 BC_BLOCK_PIXELS = 16;
+
+/** RGB of a 5:6:5 endpoint, bits replicated into the low bits as the hardware does */
+static void Unpack565(uint16 Color, int32 Out[3])
+{
+	const int32 R = (Color >> 11) & 0x1F;
+	const int32 G = (Color >> 5) & 0x3F;
+	const int32 B = Color & 0x1F;
+	Out[0] = (R << 3) | (R >> 2);
+	Out[1] = (G << 2) | (G >> 4);
+	Out[2] = (B << 3) | (B >> 2);
+}
+
+static uint16 Pack565(float R, float G, float B)
+{
+	const int32 R5 = FMath::Clamp(FMath::RoundToInt(R * 31.0f / 255.0f), 0, 31);
+	const int32 G6 = FMath::Clamp(FMath::RoundToInt(G * 63.0f / 255.0f), 0, 63);
+	const int32 B5 = FMath::Clamp(FMath::RoundToInt(B * 31.0f / 255.0f), 0, 31);
+	return (uint16)((R5 << 11) | (G6 << 5) | B5);
+}
+
+/** The four colors of a block in 4 color mode, index 2 and 3 at 1/3 and 2/3 from Color0 */
+static void BuildColorPalette(uint16 Color0, uint16 Color1, int32 Palette[4][3])
+{
+	Unpack565(Color0, Palette[0]);
+	Unpack565(Color1, Palette[1]);
+	for (int32 c = 0; c < 3; c++)
+	{
+		Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+		Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+	}// end of for
+}
+
+/** Pick the nearest palette entry for each pixel, returns the summed squared error */
+static int32 MatchColorIndices(const int32 Pixels[BC_BLOCK_PIXELS][4], const int32 Palette[4][3], uint8 OutIndices[BC_BLOCK_PIXELS])
+{
+	int32 TotalError = 0;
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		int32 BestError = MAX_int32;
+		for (int32 p = 0; p < 4; p++)
+		{
+			const int32 DR = Pixels[i][0] - Palette[p][0];
+			const int32 DG = Pixels[i][1] - Palette[p][1];
+			const int32 DB = Pixels[i][2] - Palette[p][2];
+			const int32 Error = DR * DR + DG * DG + DB * DB;
+			if (Error < BestError)
+			{
+				BestError = Error;
+				OutIndices[i] = (uint8)p;
+			}
+		}// end of for
+		TotalError += BestError;
+	}// end of for
+	return TotalError;
+}
+
+/**
+ * Least squares endpoints for the given indices, each pixel being Color0 * (1 - t) + Color1 * t.
+ * Returns false when all pixels share one index and the system has no solution.
+ */
+static bool SolveColorEndpoints(const int32 Pixels[BC_BLOCK_PIXELS][4], const uint8 Indices[BC_BLOCK_PIXELS], uint16& OutColor0, uint16& OutColor1)
+{
+	static const float Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	float AA = 0, AB = 0, BB = 0;
+	float AX[3] = { 0, 0, 0 };
+	float BX[3] = { 0, 0, 0 };
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		const float T = Weights[Indices[i]];
+		const float S = 1.0f - T;
+		AA += S * S;
+		AB += S * T;
+		BB += T * T;
+		for (int32 c = 0; c < 3; c++)
+		{
+			AX[c] += S * Pixels[i][c];
+			BX[c] += T * Pixels[i][c];
+		}// end of for
+	}// end of for
+
+	const float Det = AA * BB - AB * AB;
+	if (FMath::Abs(Det) < 1e-4f)
+		return false;
+
+	float C0[3], C1[3];
+	for (int32 c = 0; c < 3; c++)
+	{
+		C0[c] = (AX[c] * BB - BX[c] * AB) / Det;
+		C1[c] = (BX[c] * AA - AX[c] * AB) / Det;
+	}// end of for
+	OutColor0 = Pack565(C0[0], C0[1], C0[2]);
+	OutColor1 = Pack565(C1[0], C1[1], C1[2]);
+	return true;
+}
+
+/** Endpoints and indices of one BC1 color block, always in 4 color mode so it also serves BC3 */
+static void EncodeColorBlock(const int32 Pixels[BC_BLOCK_PIXELS][4], uint8* OutBlock)
+{
+	//-- endpoints at the extremes of the principal axis of the colors
+	float Mean[3] = { 0, 0, 0 };
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+		for (int32 c = 0; c < 3; c++)
+			Mean[c] += Pixels[i][c];
+	for (int32 c = 0; c < 3; c++)
+		Mean[c] /= BC_BLOCK_PIXELS;
+
+	float Cov[6] = { 0, 0, 0, 0, 0, 0 };	// rr rg rb gg gb bb
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		const float R = Pixels[i][0] - Mean[0];
+		const float G = Pixels[i][1] - Mean[1];
+		const float B = Pixels[i][2] - Mean[2];
+		Cov[0] += R * R; Cov[1] += R * G; Cov[2] += R * B;
+		Cov[3] += G * G; Cov[4] += G * B; Cov[5] += B * B;
+	}// end of for
+
+	float Axis[3] = { 1, 1, 1 };
+	for (int32 Iteration = 0; Iteration < 4; Iteration++)
+	{
+		const float X = Cov[0] * Axis[0] + Cov[1] * Axis[1] + Cov[2] * Axis[2];
+		const float Y = Cov[1] * Axis[0] + Cov[3] * Axis[1] + Cov[4] * Axis[2];
+		const float Z = Cov[2] * Axis[0] + Cov[4] * Axis[1] + Cov[5] * Axis[2];
+		const float Length = FMath::Max(FMath::Max(FMath::Abs(X), FMath::Abs(Y)), FMath::Abs(Z));
+		if (Length < 1e-4f)
+			break;
+		Axis[0] = X / Length;
+		Axis[1] = Y / Length;
+		Axis[2] = Z / Length;
+	}// end of for
+
+	int32 MinPixel = 0, MaxPixel = 0;
+	float MinDot = MAX_flt, MaxDot = -MAX_flt;
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		const float Dot = Pixels[i][0] * Axis[0] + Pixels[i][1] * Axis[1] + Pixels[i][2] * Axis[2];
+		if (Dot < MinDot)
+		{
+			MinDot = Dot;
+			MinPixel = i;
+		}
+		if (Dot > MaxDot)
+		{
+			MaxDot = Dot;
+			MaxPixel = i;
+		}
+	}// end of for
+
+	uint16 Color0 = Pack565(Pixels[MaxPixel][0], Pixels[MaxPixel][1], Pixels[MaxPixel][2]);
+	uint16 Color1 = Pack565(Pixels[MinPixel][0], Pixels[MinPixel][1], Pixels[MinPixel][2]);
+
+	int32 Palette[4][3];
+	uint8 Indices[BC_BLOCK_PIXELS];
+	BuildColorPalette(Color0, Color1, Palette);
+	int32 Error = MatchColorIndices(Pixels, Palette, Indices);
+
+	//-- one least squares refinement, kept only when it lowers the error
+	uint16 Refined0, Refined1;
+	if (Error > 0 && SolveColorEndpoints(Pixels, Indices, Refined0, Refined1))
+	{
+		int32 RefinedPalette[4][3];
+		uint8 RefinedIndices[BC_BLOCK_PIXELS];
+		BuildColorPalette(Refined0, Refined1, RefinedPalette);
+		const int32 RefinedError = MatchColorIndices(Pixels, RefinedPalette, RefinedIndices);
+		if (RefinedError < Error)
+		{
+			Color0 = Refined0;
+			Color1 = Refined1;
+			FMemory::Memcpy(Indices, RefinedIndices, sizeof(Indices));
+		}
+	}
+
+	//-- Color0 > Color1 selects 4 color mode, swapping the endpoints swaps index 0/1 and 2/3
+	if (Color0 < Color1)
+	{
+		Swap(Color0, Color1);
+		for (uint8& Index : Indices)
+			Index ^= 1;
+	}
+	else if (Color0 == Color1)
+	{
+		FMemory::Memzero(Indices, sizeof(Indices));
+	}
+
+	uint32 IndexBits = 0;
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+		IndexBits |= (uint32)Indices[i] << (i * 2);
+
+	OutBlock[0] = Color0 & 0xFF;
+	OutBlock[1] = Color0 >> 8;
+	OutBlock[2] = Color1 & 0xFF;
+	OutBlock[3] = Color1 >> 8;
+	OutBlock[4] = IndexBits & 0xFF;
+	OutBlock[5] = (IndexBits >> 8) & 0xFF;
+	OutBlock[6] = (IndexBits >> 16) & 0xFF;
+	OutBlock[7] = IndexBits >> 24;
+}
+
+/** The eight alphas of a BC3 alpha block, six interpolated when Alpha0 > Alpha1, else four plus 0 and 255 */
+static void BuildAlphaPalette(int32 Alpha0, int32 Alpha1, int32 Palette[8])
+{
+	Palette[0] = Alpha0;
+	Palette[1] = Alpha1;
+	if (Alpha0 > Alpha1)
+	{
+		for (int32 i = 1; i < 7; i++)
+			Palette[i + 1] = ((7 - i) * Alpha0 + i * Alpha1) / 7;
+	}
+	else
+	{
+		for (int32 i = 1; i < 5; i++)
+			Palette[i + 1] = ((5 - i) * Alpha0 + i * Alpha1) / 5;
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+}
+
+static void EncodeAlphaBlock(const int32 Pixels[BC_BLOCK_PIXELS][4], uint8* OutBlock)
+{
+	int32 MinAlpha = 255, MaxAlpha = 0;
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		MinAlpha = FMath::Min(MinAlpha, Pixels[i][3]);
+		MaxAlpha = FMath::Max(MaxAlpha, Pixels[i][3]);
+	}// end of for
+
+	// equal endpoints select the 6 value mode, where index 0 still is Alpha0
+	int32 Palette[8];
+	BuildAlphaPalette(MaxAlpha, MinAlpha, Palette);
+
+	uint64 IndexBits = 0;
+	for (int32 i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		int32 BestIndex = 0;
+		int32 BestError = MAX_int32;
+		for (int32 p = 0; p < 8; p++)
+		{
+			const int32 Error = FMath::Abs(Pixels[i][3] - Palette[p]);
+			if (Error < BestError)
+			{
+				BestError = Error;
+				BestIndex = p;
+			}
+		}// end of for
+		IndexBits |= (uint64)BestIndex << (i * 3);
+	}// end of for
+
+	OutBlock[0] = (uint8)MaxAlpha;
+	OutBlock[1] = (uint8)MinAlpha;
+	for (int32 i = 0; i < 6; i++)
+		OutBlock[2 + i] = (IndexBits >> (i * 8)) & 0xFF;
+}
+
+uint32 GetBCBlockBytes(EPixelFormat Format)
+{
+	return Format == PF_DXT1 ? 8 : 16;
+}
+
+uint32 GetBCImageSize(uint32 Width, uint32 Height, EPixelFormat Format)
+{
+	return ((Width + 3) / 4) * ((Height + 3) / 4) * GetBCBlockBytes(Format);
+}
+
+void EncodeBCImage(const FColor* Pixels, uint32 Width, uint32 Height, EPixelFormat Format, uint8* OutBlocks)
+{
+	check(Format == PF_DXT1 || Format == PF_DXT5);
+	const uint32 BlockBytes = GetBCBlockBytes(Format);
+
+	for (uint32 BlockY = 0; BlockY < Height; BlockY += 4)
+	{
+		for (uint32 BlockX = 0; BlockX < Width; BlockX += 4)
+		{
+			int32 Block[BC_BLOCK_PIXELS][4];
+			for (uint32 y = 0; y < 4; y++)
+			{
+				const FColor* Row = Pixels + Width * FMath::Min(BlockY + y, Height - 1);
+				for (uint32 x = 0; x < 4; x++)
+				{
+					const FColor& Pixel = Row[FMath::Min(BlockX + x, Width - 1)];
+					int32* Out = Block[y * 4 + x];
+					Out[0] = Pixel.R;
+					Out[1] = Pixel.G;
+					Out[2] = Pixel.B;
+					Out[3] = Pixel.A;
+				}// end of for
+			}// end of for
+
+			if (Format == PF_DXT5)
+			{
+				EncodeAlphaBlock(Block, OutBlocks);
+				EncodeColorBlock(Block, OutBlocks + 8);
+			}
+			else
+			{
+				EncodeColorBlock(Block, OutBlocks);
+			}
+			OutBlocks += BlockBytes;
+		}// end of for
+	}// end of for
+}
+
+void DecodeBCImage(const uint8* Blocks, uint32 Width, uint32 Height, EPixelFormat Format, FColor* OutPixels)
+{
+	check(Format == PF_DXT1 || Format == PF_DXT5);
+	const uint32 BlockBytes = GetBCBlockBytes(Format);
+
+	for (uint32 BlockY = 0; BlockY < Height; BlockY += 4)
+	{
+		for (uint32 BlockX = 0; BlockX < Width; BlockX += 4)
+		{
+			int32 Alphas[8] = { 255, 255, 255, 255, 255, 255, 255, 255 };
+			uint64 AlphaBits = 0;
+			const uint8* ColorBlock = Blocks;
+			if (Format == PF_DXT5)
+			{
+				BuildAlphaPalette(Blocks[0], Blocks[1], Alphas);
+				for (int32 i = 0; i < 6; i++)
+					AlphaBits |= (uint64)Blocks[2 + i] << (i * 8);
+				ColorBlock += 8;
+			}
+
+			// BC3 color blocks are always read in 4 color mode
+			const uint16 Color0 = ColorBlock[0] | (ColorBlock[1] << 8);
+			const uint16 Color1 = ColorBlock[2] | (ColorBlock[3] << 8);
+			int32 Palette[4][3];
+			BuildColorPalette(Color0, Color1, Palette);
+			bool bPunchThrough = false;
+			if (Format == PF_DXT1 && Color0 <= Color1)
+			{
+				for (int32 c = 0; c < 3; c++)
+				{
+					Palette[2][c] = (Palette[0][c] + Palette[1][c]) / 2;
+					Palette[3][c] = 0;
+				}// end of for
+				bPunchThrough = true;
+			}
+			const uint32 ColorBits = ColorBlock[4] | (ColorBlock[5] << 8) | (ColorBlock[6] << 16) | ((uint32)ColorBlock[7] << 24);
+
+			for (uint32 y = 0; y < 4 && BlockY + y < Height; y++)
+			{
+				for (uint32 x = 0; x < 4 && BlockX + x < Width; x++)
+				{
+					const uint32 i = y * 4 + x;
+					const uint32 ColorIndex = (ColorBits >> (i * 2)) & 3;
+					FColor& Out = OutPixels[(BlockY + y) * Width + BlockX + x];
+					Out.R = (uint8)Palette[ColorIndex][0];
+					Out.G = (uint8)Palette[ColorIndex][1];
+					Out.B = (uint8)Palette[ColorIndex][2];
+					Out.A = (uint8)Alphas[(AlphaBits >> (i * 3)) & 7];
+					if (bPunchThrough && ColorIndex == 3)
+						Out.A = 0;
+				}// end of for
+			}// end of for
+			Blocks += BlockBytes;
+		}// end of for
+	}// end of for
+}
@@ -0,0 +1,31 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+/** Bytes of one 4x4 block, 8 for PF_DXT1 and 16 for PF_DXT5 */
+ANIMATEDTEXTURE_API uint32 GetBCBlockBytes(EPixelFormat Format);
+
+/** Bytes of a Width x Height image, both sides rounded up to whole blocks */
+ANIMATEDTEXTURE_API uint32 GetBCImageSize(uint32 Width, uint32 Height, EPixelFormat Format);
+
+/**
+ * Block compress BGRA pixels on the CPU, rows are Width pixels.
+ * PF_DXT1 (BC1) drops the alpha, PF_DXT5 (BC3) keeps it in an interpolated alpha block.
+ * Blocks past the right or bottom edge repeat the last column or row.
+ */
+ANIMATEDTEXTURE_API void EncodeBCImage(const FColor* Pixels, uint32 Width, uint32 Height, EPixelFormat Format, uint8* OutBlocks);
+
+/** Inverse of EncodeBCImage, decodes the blocks as the GPU would sample them */
+ANIMATEDTEXTURE_API void DecodeBCImage(const uint8* Blocks, uint32 Width, uint32 Height, EPixelFormat Format, FColor* OutPixels);
@@ -0,0 +1,495 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "GIFDecoder.h"
+#include "AnimatedTextureStats.h"
+
+#include "Async/ParallelFor.h"	// Core
+#include "Templates/Atomic.h"	// Core
+#include "gif_load/gif_load.h" // from: https://github.com/hidefromkgb/gif_load
+
+int32 FGIFParseResult::AddPalette(const uint8* RGB, uint32 NumColors, int32 TransparentIndex)
+{
+	FColor Colors[GIF_PALETTE_COLORS];
+	NumColors = FMath::Min<uint32>(NumColors, GIF_PALETTE_COLORS);
+	for (uint32 i = 0; i < NumColors; i++)
+		Colors[i] = FColor(RGB[i * 3], RGB[i * 3 + 1], RGB[i * 3 + 2], 255);
+	for (uint32 i = NumColors; i < GIF_PALETTE_COLORS; i++)
+		Colors[i] = FColor(0, 0, 0, 255);
+
+	if (TransparentIndex >= 0 && TransparentIndex < GIF_PALETTE_COLORS)
+		Colors[TransparentIndex].A = 0;
+
+	return AddPalette(Colors);
+}
+
+int32 FGIFParseResult::AddPalette(const FColor* Colors)
+{
+	const uint32 PaletteBytes = GIF_PALETTE_COLORS * sizeof(FColor);
+	const uint32 Hash = FCrc::MemCrc32(Colors, PaletteBytes);
+
+	TArray<int32, TInlineAllocator<4>> Candidates;
+	PaletteLookup.MultiFind(Hash, Candidates);
+	for (int32 Candidate : Candidates)
+	{
+		if (FMemory::Memcmp(Palettes.GetData() + Candidate * GIF_PALETTE_COLORS, Colors, PaletteBytes) == 0)
+			return Candidate;
+	}
+
+	int32 Index = Palettes.Num() / GIF_PALETTE_COLORS;
+	Palettes.Append(Colors, GIF_PALETTE_COLORS);
+	PaletteLookup.Add(Hash, Index);
+	return Index;
+}
+
+void GIFFrameLoader1(void* data, struct GIF_WHDR* whdr)
+{
+	FGIFParseResult* OutGIF = (FGIFParseResult*)data;
+
+	//-- init on first frame
+	if (OutGIF->Frames.Num() == 0) {
+		OutGIF->GlobalWidth = whdr->xdim;
+		OutGIF->GlobalHeight = whdr->ydim;
+		OutGIF->Background = whdr->bkgd;
+		OutGIF->Frames.SetNum(FMath::Abs(whdr->nfrm));	// negative while the data is incomplete
+	}
+
+	//-- import frame
+	int FrameIndex = whdr->ifrm;
+
+	check(FrameIndex >= 0 && FrameIndex < OutGIF->Frames.Num());
+
+	FGIFFrame& Frame = OutGIF->Frames[FrameIndex];
+
+	//-- copy properties
+	if (whdr->time >= 0)
+		Frame.Time = whdr->time * 0.01f;	// 1 GIF time units = 10 msec
+	else
+		Frame.Time = (-whdr->time - 1) * 0.01f;
+
+	/** [TODO:] the frame is assumed to be inside global bounds,
+			however it might exceed them in some GIFs; fix me. **/
+	Frame.Index = whdr->ifrm;
+	Frame.Width = whdr->frxd;
+	Frame.Height = whdr->fryd;
+	Frame.OffsetX = whdr->frxo;
+	Frame.OffsetY = whdr->fryo;
+	Frame.Interlacing = whdr->intr != 0;
+	Frame.Mode = whdr->mode;
+	Frame.TransparentIndex = whdr->tran;
+
+	//-- copy pixel data
+	int NumPixel = Frame.Width * Frame.Height;
+	Frame.PixelIndices.SetNumUninitialized(NumPixel);
+	FMemory::Memcpy(Frame.PixelIndices.GetData(), whdr->bptr, NumPixel);
+
+	//-- share pal
+	Frame.PaletteIndex = OutGIF->AddPalette((const uint8*)whdr->cpal, whdr->clrs, whdr->tran);
+}
+
+
+/** Body of ScanGIFBinary, false if the file does not end properly */
+static bool ScanFrameTable(FGIFParseResult& OutGIF, const uint8* Buffer, uint32 BufferSize)
+{
+	const uint8 GIF_EHDM = 0x21;	// extension header mark
+	const uint8 GIF_FHDM = 0x2C;	// frame header mark
+	const uint8 GIF_EOFM = 0x3B;	// end-of-file mark
+	const uint8 GIF_EGCM = 0xF9;	// extension: graphics control mark
+
+	OutGIF = FGIFParseResult();
+
+	//-- logical screen descriptor: signature, width, height, flags, background, aspect
+	if (!Buffer || BufferSize <= 13 || !isGifData(Buffer))
+		return false;
+
+	OutGIF.GlobalWidth = Buffer[6] | (Buffer[7] << 8);
+	OutGIF.GlobalHeight = Buffer[8] | (Buffer[9] << 8);
+	OutGIF.Background = Buffer[11];
+
+	const uint8 GlobalFlags = Buffer[10];
+	const uint32 GlobalPaletteSize = (GlobalFlags & 0x80) ? (2 << (GlobalFlags & 7)) : 0;
+	const uint8* GlobalPalette = Buffer + 13;
+
+	uint32 Pos = 13 + GlobalPaletteSize * 3;
+	const uint8* Control = nullptr;	// pending graphics control extension
+
+	auto SkipSubBlocks = [&]()
+	{
+		while (Pos < BufferSize && Buffer[Pos] != 0)
+			Pos += 1 + Buffer[Pos];
+		Pos++;	// block terminator
+	};
+
+	bool bFinished = false;
+	while (Pos < BufferSize)
+	{
+		const uint8 Desc = Buffer[Pos++];
+		if (Desc == GIF_EOFM)
+		{
+			bFinished = true;
+			break;
+		}
+		else if (Desc == GIF_EHDM)
+		{
+			if (Pos + 6 <= BufferSize && Buffer[Pos] == GIF_EGCM)
+				Control = Buffer + Pos + 2;	// skip label and block size
+			Pos++;	// label
+			SkipSubBlocks();
+		}
+		else if (Desc == GIF_FHDM)
+		{
+			const uint32 DescOffset = Pos - 1;
+			if (Pos + 9 > BufferSize)
+				break;
+
+			const uint8* Header = Buffer + Pos;
+			const uint8 Flags = Header[8];
+			Pos += 9;
+
+			const uint8* Palette = GlobalPalette;
+			uint32 PaletteSize = GlobalPaletteSize;
+			if (Flags & 0x80)	// local palette has priority
+			{
+				Palette = Buffer + Pos;
+				PaletteSize = 2 << (Flags & 7);
+				Pos += PaletteSize * 3;
+			}
+			if (PaletteSize == 0 || Pos >= BufferSize)
+				break;
+
+			FGIFFrame& Frame = OutGIF.Frames.AddDefaulted_GetRef();
+			Frame.Index = OutGIF.Frames.Num() - 1;
+			Frame.OffsetX = Header[0] | (Header[1] << 8);
+			Frame.OffsetY = Header[2] | (Header[3] << 8);
+			Frame.Width = Header[4] | (Header[5] << 8);
+			Frame.Height = Header[6] | (Header[7] << 8);
+			Frame.Interlacing = (Flags & 0x40) != 0;
+			Frame.DataOffset = DescOffset;
+
+			//-- same interpretation of the graphics control block as gif_load
+			if (Control)
+			{
+				const uint8 ControlFlags = Control[0];
+				Frame.Time = (Control[1] | (Control[2] << 8)) * 0.01f;	// 1 GIF time units = 10 msec
+				Frame.TransparentIndex = (ControlFlags & 0x01) ? Control[3] : -1;
+				Frame.Mode = !(ControlFlags & 0x10) ? (ControlFlags & 0x0C) >> 2 : GIF_NONE;
+				Control = nullptr;
+			}
+
+			Frame.PaletteIndex = OutGIF.AddPalette(Palette, PaletteSize, Frame.TransparentIndex);
+
+			Pos++;	// LZW minimum code size
+			SkipSubBlocks();
+		}
+		else
+		{
+			break;	// unknown block
+		}
+	}// end of while
+
+	return bFinished;
+}
+
+/** Decode every frame of the table, each frame's LZW stream is independent of the others */
+static bool DecodeFrameTable(FGIFParseResult& GIF, const uint8* Buffer, uint32 BufferSize)
+{
+	uint64 NumPixel = 0;
+	for (const FGIFFrame& Frame : GIF.Frames)
+		NumPixel += Frame.Width * Frame.Height;
+
+	// below this the task dispatch costs more than it saves
+	const uint64 MinParallelPixels = 256 * 256;
+	const bool bSingleThread = GIF.Frames.Num() < 2 || NumPixel < MinParallelPixels;
+
+	TAtomic<bool> bSucceeded(true);
+	ParallelFor(GIF.Frames.Num(), [&GIF, Buffer, BufferSize, &bSucceeded](int32 FrameIndex)
+	{
+		FGIFFrame& Frame = GIF.Frames[FrameIndex];
+		TArray<uint8> Scratch;
+		const uint8* Pixels = DecodeGIFFrame(Buffer, BufferSize, Frame, Scratch);
+		if (!Pixels)
+		{
+			bSucceeded = false;
+			return;
+		}
+
+		const uint32 FramePixels = Frame.Width * Frame.Height;
+		Frame.PixelIndices.SetNumUninitialized(FramePixels);
+		FMemory::Memcpy(Frame.PixelIndices.GetData(), Pixels, FramePixels);
+	}, bSingleThread);
+
+	return bSucceeded;
+}
+
+bool LoadGIFBinary(FGIFParseResult& OutGIF, const uint8* Buffer, uint32 BufferSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexParse);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Parse);
+
+	//-- index the frames, then decode them in parallel
+	if (ScanFrameTable(OutGIF, Buffer, BufferSize) && DecodeFrameTable(OutGIF, Buffer, BufferSize))
+		return true;
+
+	//-- truncated or unusual files: gif_load keeps every frame it can read
+	OutGIF = FGIFParseResult();
+	int Ret = GIF_Load((void*)Buffer, BufferSize, GIFFrameLoader1, 0, (void*)&OutGIF, 0L);
+
+	if (Ret < 0) {
+		UE_LOG(LogTexture, Warning, TEXT("gif format error."));
+		return false;
+	}
+	return true;
+}
+
+bool ScanGIFBinary(FGIFParseResult& OutGIF, const uint8* Buffer, uint32 BufferSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexParse);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, Parse);
+
+	bool bFinished = ScanFrameTable(OutGIF, Buffer, BufferSize);
+	if (!bFinished)
+		UE_LOG(LogTexture, Warning, TEXT("gif format error."));
+	return bFinished;
+}
+
+/** Offset of the LZW minimum code size byte of a frame found by ScanGIFBinary, 0 if its image descriptor is not there */
+static uint32 FindFrameImageData(const uint8* Buffer, uint32 BufferSize, const FGIFFrame& Frame)
+{
+	//-- image descriptor: separator, left, top, width, height, flags, [local palette]
+	uint32 Pos = Frame.DataOffset;
+	if (!Buffer || Pos + 10 >= BufferSize || Buffer[Pos] != 0x2C)
+		return 0;
+
+	const uint8 Flags = Buffer[Pos + 9];
+	Pos += 10;
+	if (Flags & 0x80)
+		Pos += 3 * (2 << (Flags & 7));
+	return Pos < BufferSize ? Pos : 0;
+}
+
+/** Copy a string decoded before, Src + Count reaches past Dest only for a code defined by itself */
+static FORCEINLINE void CopyPixelString(uint8* Pixels, uint32 Dest, uint32 Src, uint32 Count)
+{
+	if (Dest - Src >= 8)
+	{
+		// 8 bytes at a time, may write up to 7 bytes past the string into the slack of the pixel buffer
+		for (uint32 i = 0; i < Count; i += 8)
+		{
+			uint64 Chunk;
+			FMemory::Memcpy(&Chunk, Pixels + Src + i, sizeof(Chunk));
+			FMemory::Memcpy(Pixels + Dest + i, &Chunk, sizeof(Chunk));
+		}// end of for
+	}
+	else
+	{
+		for (uint32 i = 0; i < Count; i++)
+			Pixels[Dest + i] = Pixels[Src + i];
+	}
+}
+
+static const uint32 GIF_CODE_COUNT = 1 << 12;
+static const uint32 GIF_PIXEL_SLACK = 16;	// CopyPixelString overrun, and room for the 64 bit refills of the stream
+
+/**
+ * LZW decode the data sub-blocks of a frame gathered in one stream, same output as _GIF_LoadFrame of gif_load on valid data.
+ * A stream decoding to more than NumPixel pixels is clipped, gif_load drops the whole last string instead.
+ * Every code is stored as the position and length of its first occurrence in the pixels, so a code is one block copy.
+ * @param Stream	StreamSize bytes followed by GIF_PIXEL_SLACK zeros
+ * @param LastBlockStart	offset of the last sub-block in Stream, the end code must be in it
+ * @param Pixels	NumPixel bytes followed by GIF_PIXEL_SLACK bytes
+ */
+static bool DecodeGIFCodes(uint32 MinCodeSize, const uint8* Stream, uint32 StreamSize, uint32 LastBlockStart, uint8* Pixels, uint32 NumPixel, uint32* Offsets, uint16* Lengths)
+{
+	if (MinCodeSize < 2 || MinCodeSize > 8 || StreamSize == 0)
+		return false;
+
+	const uint32 ClearCode = 1 << MinCodeSize;
+	const uint32 EndCode = ClearCode + 1;
+	for (uint32 i = 0; i < ClearCode; i++)
+		Lengths[i] = 1;
+
+	const uint64 TotalBits = (uint64)StreamSize * 8;
+	uint64 BitPos = 0;
+	uint64 Bits = 0;	// next bits of the stream, LSB first
+	uint32 NumBits = 0;
+	const uint8* In = Stream;
+
+	uint32 CodeSize = MinCodeSize + 1;
+	uint32 CodeMask = (1 << CodeSize) - 1;
+	uint32 NextCode = EndCode + 1;
+	uint32 Prev = GIF_CODE_COUNT;	// none right after a clear code
+	uint32 PrevPos = 0;
+	uint32 Pos = 0;
+	bool bSucceeded = true;
+
+	for (bool bFirstCode = true; ; bFirstCode = false)
+	{
+		// no end code before the end of the stream still counts as decoded, see _GIF_LoadFrame
+		if (BitPos + CodeSize > TotalBits)
+			break;
+
+		if (NumBits < CodeSize)
+		{
+			uint64 Word;
+			FMemory::Memcpy(&Word, In, sizeof(Word));
+			Bits |= Word << NumBits;
+			In += (63 - NumBits) >> 3;
+			NumBits |= 56;
+		}
+
+		const uint32 Code = Bits & CodeMask;
+		Bits >>= CodeSize;
+		NumBits -= CodeSize;
+		BitPos += CodeSize;
+
+		if (bFirstCode && Code != ClearCode)
+			return false;
+
+		if (Code == ClearCode)
+		{
+			CodeSize = MinCodeSize + 1;
+			CodeMask = (1 << CodeSize) - 1;
+			NextCode = EndCode + 1;
+			Prev = GIF_CODE_COUNT;
+			continue;
+		}
+		if (Code == EndCode)
+		{
+			bSucceeded = (BitPos - 1) / 8 >= LastBlockStart;
+			break;
+		}
+
+		//-- emit the string of the code
+		uint32 Length;
+		if (Code < ClearCode)
+		{
+			Length = 1;
+			if (Pos < NumPixel)
+				Pixels[Pos] = (uint8)Code;
+		}
+		else
+		{
+			uint32 Src;
+			if (Code < NextCode)
+			{
+				Src = Offsets[Code];
+				Length = Lengths[Code];
+			}
+			else if (Code == NextCode && Prev != GIF_CODE_COUNT)
+			{
+				// the previous string plus its own first pixel
+				Src = PrevPos;
+				Length = Lengths[Prev] + 1;
+			}
+			else
+			{
+				return false;	// wrong code in the stream
+			}
+
+			// pixels above the frame capacity are skipped
+			if (Pos < NumPixel)
+				CopyPixelString(Pixels, Pos, Src, FMath::Min(Length, NumPixel - Pos));
+		}
+
+		//-- the previous string plus the first pixel of this one
+		if (Prev != GIF_CODE_COUNT && NextCode < GIF_CODE_COUNT)
+		{
+			Offsets[NextCode] = PrevPos;
+			Lengths[NextCode] = Lengths[Prev] + 1;
+			NextCode++;
+			if (NextCode > CodeMask && CodeSize < 12)
+			{
+				CodeSize++;
+				CodeMask = (1 << CodeSize) - 1;
+			}
+		}
+
+		Prev = Code;
+		PrevPos = Pos;
+		Pos += Length;
+	}// end of for
+
+	if (bSucceeded && Pos < NumPixel)
+		FMemory::Memzero(Pixels + Pos, NumPixel - Pos);
+	return bSucceeded;
+}
+
+const uint8* DecodeGIFFrame(const uint8* Buffer, uint32 BufferSize, const FGIFFrame& Frame, TArray<uint8>& Scratch)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimTexDecodeFrame);
+	CSV_SCOPED_TIMING_STAT(AnimatedTexture, DecodeFrame);
+
+	const uint32 DataPos = FindFrameImageData(Buffer, BufferSize, Frame);
+	if (DataPos == 0)
+		return nullptr;
+
+	//-- measure the data sub-blocks, the stream must be terminated
+	uint32 StreamSize = 0;
+	uint32 LastBlockStart = 0;
+	uint32 Pos = DataPos + 1;
+	bool bTerminated = false;
+	while (Pos < BufferSize)
+	{
+		const uint32 BlockSize = Buffer[Pos];
+		if (BlockSize == 0)
+		{
+			bTerminated = true;
+			break;
+		}
+		if (Pos + 1 + BlockSize > BufferSize)
+			break;
+
+		LastBlockStart = StreamSize;
+		StreamSize += BlockSize;
+		Pos += 1 + BlockSize;
+	}// end of while
+
+	if (!bTerminated || StreamSize == 0)
+		return nullptr;
+
+	//-- scratch: pixels, code table, stream, each followed by its slack
+	const uint32 NumPixel = Frame.Width * Frame.Height;
+	const uint32 PixelsSize = Align(NumPixel + GIF_PIXEL_SLACK, 16);
+	const uint32 OffsetsSize = GIF_CODE_COUNT * sizeof(uint32);
+	const uint32 LengthsSize = GIF_CODE_COUNT * sizeof(uint16);
+	Scratch.SetNumUninitialized(PixelsSize + OffsetsSize + LengthsSize + StreamSize + GIF_PIXEL_SLACK, false);
+
+	uint8* Pixels = Scratch.GetData();
+	uint32* Offsets = (uint32*)(Pixels + PixelsSize);
+	uint16* Lengths = (uint16*)(Pixels + PixelsSize + OffsetsSize);
+	uint8* Stream = Pixels + PixelsSize + OffsetsSize + LengthsSize;
+
+	//-- gather the sub-blocks, so codes are read 64 bits at a time
+	uint8* StreamEnd = Stream;
+	for (Pos = DataPos + 1; Buffer[Pos] != 0; Pos += 1 + Buffer[Pos])
+	{
+		FMemory::Memcpy(StreamEnd, Buffer + Pos + 1, Buffer[Pos]);
+		StreamEnd += Buffer[Pos];
+	}// end of for
+	FMemory::Memzero(StreamEnd, GIF_PIXEL_SLACK);
+
+	if (!DecodeGIFCodes(Buffer[DataPos], Stream, StreamSize, LastBlockStart, Pixels, NumPixel, Offsets, Lengths))
+		return nullptr;
+
+	return Pixels;
+}
+
+const uint8* DecodeGIFFrameReference(const uint8* Buffer, uint32 BufferSize, const FGIFFrame& Frame, TArray<uint8>& Scratch)
+{
+	// gif_load keeps its code table right in front of the pixels
+	const uint32 CodeTableSize = (1 << 12) * sizeof(uint32_t);
+
+	const uint32 Pos = FindFrameImageData(Buffer, BufferSize, Frame);
+	if (Pos == 0)
+		return nullptr;
+
+	const uint32 NumPixel = Frame.Width * Frame.Height;
+	Scratch.SetNumUninitialized(CodeTableSize + NumPixel + 2, false);	// +2: excess pixel codes, see GIF_Load
+
+	uint8_t* Pixels = Scratch.GetData() + CodeTableSize;
+	uint8_t* Buff = (uint8_t*)Buffer + Pos;
+	long Size = BufferSize - Pos;
+	if (_GIF_LoadFrame(&Buff, &Size, Pixels, Pixels + NumPixel) < 0)
+		return nullptr;
+
+	return Pixels;
+}
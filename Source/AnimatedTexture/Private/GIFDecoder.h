@@ -0,0 +1,56 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimatedTexture2D.h"
+
+struct FGIFParseResult
+{
+	uint32 GlobalWidth = 0;
+	uint32 GlobalHeight = 0;
+	uint8 Background = 0;
+	TArray<FGIFFrame> Frames;
+	TArray<FColor> Palettes;	// GIF_PALETTE_COLORS colors each
+
+	/**
+	 * Find or add the final form of a GIF palette: padded to GIF_PALETTE_COLORS, zero alpha on the transparent color
+	 * @param RGB	NumColors * 3 bytes as stored in the file
+	 * @return index for FGIFFrame::PaletteIndex
+	 */
+	int32 AddPalette(const uint8* RGB, uint32 NumColors, int32 TransparentIndex);
+
+	/** Find or add a palette already in its final form */
+	int32 AddPalette(const FColor* Colors);
+
+private:
+	TMultiMap<uint32, int32> PaletteLookup;	// content hash -> palette index
+};
+
+/** Decode every frame of a GIF file with gif_load */
+ANIMATEDTEXTURE_API bool LoadGIFBinary(FGIFParseResult& OutGIF, const uint8* Buffer, uint32 BufferSize);
+
+/**
+ * Build the frame table without decoding any pixel,
+ * each frame records the offset of its image descriptor in Buffer
+ */
+ANIMATEDTEXTURE_API bool ScanGIFBinary(FGIFParseResult& OutGIF, const uint8* Buffer, uint32 BufferSize);
+
+/**
+ * Decode the pixel indices of a single frame found by ScanGIFBinary
+ * @param Scratch	reusable working memory, holds the LZW code table and the pixels
+ * @return pixel indices inside Scratch, nullptr on corrupted data
+ */
+ANIMATEDTEXTURE_API const uint8* DecodeGIFFrame(const uint8* Buffer, uint32 BufferSize, const FGIFFrame& Frame, TArray<uint8>& Scratch);
+
+/** DecodeGIFFrame with the LZW decoder of gif_load, the reference its output is checked against */
+ANIMATEDTEXTURE_API const uint8* DecodeGIFFrameReference(const uint8* Buffer, uint32 BufferSize, const FGIFFrame& Frame, TArray<uint8>& Scratch);
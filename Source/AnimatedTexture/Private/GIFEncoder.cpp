@@ -0,0 +1,178 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "GIFEncoder.h"
+
+static const uint32 GIF_MAX_CODE = 4095;	// last code of the 12 bit table
+
+static void WriteUInt16(TArray<uint8>& OutBuffer, uint32 Value)
+{
+	OutBuffer.Add(Value & 0xFF);
+	OutBuffer.Add((Value >> 8) & 0xFF);
+}
+
+static void WritePalette(TArray<uint8>& OutBuffer, const FColor* Colors)
+{
+	for (int32 i = 0; i < GIF_PALETTE_COLORS; i++)
+	{
+		OutBuffer.Add(Colors[i].R);
+		OutBuffer.Add(Colors[i].G);
+		OutBuffer.Add(Colors[i].B);
+	}// end of for
+}
+
+void EncodeGIFImageData(const uint8* Indices, uint32 Count, uint8 MinCodeSize, TArray<uint8>& OutBuffer)
+{
+	MinCodeSize = FMath::Clamp<uint8>(MinCodeSize, 2, 8);
+	const uint32 ClearCode = 1 << MinCodeSize;
+	const uint32 EndCode = ClearCode + 1;
+
+	OutBuffer.Add(MinCodeSize);
+
+	//-- sub-blocks of at most 255 bytes, each behind its size byte
+	int32 BlockStart = INDEX_NONE;
+	auto WriteByte = [&](uint8 Byte)
+	{
+		if (BlockStart == INDEX_NONE || OutBuffer.Num() - BlockStart - 1 == 255)
+			BlockStart = OutBuffer.Add(0);
+		OutBuffer.Add(Byte);
+		OutBuffer[BlockStart]++;
+	};
+
+	uint32 CodeSize = MinCodeSize + 1;
+	uint32 NextCode = EndCode + 1;
+	uint32 BitBuffer = 0;
+	uint32 NumBits = 0;
+
+	// the decoder widens its codes one entry behind the encoder, same order as giflib
+	auto WriteCode = [&](uint32 Code)
+	{
+		BitBuffer |= Code << NumBits;
+		NumBits += CodeSize;
+		while (NumBits >= 8)
+		{
+			WriteByte(BitBuffer & 0xFF);
+			BitBuffer >>= 8;
+			NumBits -= 8;
+		}
+		if (Code != ClearCode && NextCode >= (1u << CodeSize) && CodeSize < 12)
+			CodeSize++;
+	};
+
+	TMap<uint32, uint32> Table;	// (prefix code << 8 | index) -> code
+	WriteCode(ClearCode);
+
+	if (Count > 0)
+	{
+		uint32 Prefix = Indices[0] & (ClearCode - 1);
+		for (uint32 i = 1; i < Count; i++)
+		{
+			const uint32 Index = Indices[i] & (ClearCode - 1);
+			const uint32 Key = (Prefix << 8) | Index;
+			if (const uint32* Code = Table.Find(Key))
+			{
+				Prefix = *Code;
+				continue;
+			}
+
+			WriteCode(Prefix);
+			if (NextCode < GIF_MAX_CODE)
+			{
+				Table.Add(Key, NextCode++);
+			}
+			else
+			{
+				// table full, start over
+				WriteCode(ClearCode);
+				Table.Reset();
+				NextCode = EndCode + 1;
+				CodeSize = MinCodeSize + 1;
+			}
+			Prefix = Index;
+		}// end of for
+		WriteCode(Prefix);
+	}
+	WriteCode(EndCode);
+
+	if (NumBits > 0)
+		WriteByte(BitBuffer & 0xFF);
+	OutBuffer.Add(0);	// block terminator
+}
+
+void EncodeGIFBinary(const FGIFParseResult& GIF, TArray<uint8>& OutBuffer)
+{
+	const uint8 GIF_EHDM = 0x21;	// extension header mark
+	const uint8 GIF_FHDM = 0x2C;	// frame header mark
+	const uint8 GIF_EOFM = 0x3B;	// end-of-file mark
+	const uint8 GIF_EGCM = 0xF9;	// extension: graphics control mark
+	const uint8 GIF_EAPM = 0xFF;	// extension: application mark
+
+	const int32 NumPalette = GIF.Palettes.Num() / GIF_PALETTE_COLORS;
+
+	OutBuffer.Reset();
+
+	//-- header and logical screen descriptor, 256 colors global palette
+	const char Signature[] = "GIF89a";
+	OutBuffer.Append((const uint8*)Signature, 6);
+	WriteUInt16(OutBuffer, GIF.GlobalWidth);
+	WriteUInt16(OutBuffer, GIF.GlobalHeight);
+	OutBuffer.Add(NumPalette > 0 ? 0xF7 : 0x70);
+	OutBuffer.Add(GIF.Background);
+	OutBuffer.Add(0);	// aspect ratio
+	if (NumPalette > 0)
+		WritePalette(OutBuffer, GIF.Palettes.GetData());
+
+	//-- loop forever
+	const char Netscape[] = "NETSCAPE2.0";
+	OutBuffer.Add(GIF_EHDM);
+	OutBuffer.Add(GIF_EAPM);
+	OutBuffer.Add(11);
+	OutBuffer.Append((const uint8*)Netscape, 11);
+	OutBuffer.Add(3);
+	OutBuffer.Add(1);
+	WriteUInt16(OutBuffer, 0);
+	OutBuffer.Add(0);
+
+	TArray<uint8> Interlaced;
+	for (const FGIFFrame& Frame : GIF.Frames)
+	{
+		//-- graphics control extension
+		const bool bTransparent = Frame.TransparentIndex >= 0 && Frame.TransparentIndex < GIF_PALETTE_COLORS;
+		OutBuffer.Add(GIF_EHDM);
+		OutBuffer.Add(GIF_EGCM);
+		OutBuffer.Add(4);
+		OutBuffer.Add(((Frame.Mode & 7) << 2) | (bTransparent ? 1 : 0));
+		WriteUInt16(OutBuffer, FMath::RoundToInt(Frame.Time * 100.0f));	// 1 GIF time units = 10 msec
+		OutBuffer.Add(bTransparent ? (uint8)Frame.TransparentIndex : 0);
+		OutBuffer.Add(0);
+
+		//-- image descriptor
+		const bool bLocalPalette = Frame.PaletteIndex > 0 && Frame.PaletteIndex < NumPalette;
+		OutBuffer.Add(GIF_FHDM);
+		WriteUInt16(OutBuffer, Frame.OffsetX);
+		WriteUInt16(OutBuffer, Frame.OffsetY);
+		WriteUInt16(OutBuffer, Frame.Width);
+		WriteUInt16(OutBuffer, Frame.Height);
+		OutBuffer.Add((bLocalPalette ? 0x87 : 0) | (Frame.Interlacing ? 0x40 : 0));
+		if (bLocalPalette)
+			WritePalette(OutBuffer, GIF.Palettes.GetData() + Frame.PaletteIndex * GIF_PALETTE_COLORS);
+
+		//-- pixels, interlaced frames store rows 0,8,16.. then 4,12.. then 2,6.. then 1,3..
+		const uint8* Pixels = Frame.PixelIndices.GetData();
+		const uint32 NumPixel = FMath::Min<uint32>(Frame.Width * Frame.Height, Frame.PixelIndices.Num());
+		if (Frame.Interlacing && NumPixel == Frame.Width * Frame.Height)
+		{
+			Interlaced.Reset(NumPixel);
+			const uint32 PassStart[] = { 0, 4, 2, 1 };
+			const uint32 PassStep[] = { 8, 8, 4, 2 };
+			for (int32 Pass = 0; Pass < 4; Pass++)
+			{
+				for (uint32 y = PassStart[Pass]; y < Frame.Height; y += PassStep[Pass])
+					Interlaced.Append(Pixels + y * Frame.Width, Frame.Width);
+			}// end of for
+			Pixels = Interlaced.GetData();
+		}
+		EncodeGIFImageData(Pixels, NumPixel, 8, OutBuffer);
+	}// end of for
+
+	OutBuffer.Add(GIF_EOFM);
+}
@@ -0,0 +1,28 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GIFDecoder.h"
+
+/**
+ * Write a GIF89a file, the inverse of LoadGIFBinary.
+ * Palette 0 is written as the global palette, frames using any other palette get a local one.
+ * Frames must keep their PixelIndices, rows are written in interlaced order for frames with Interlacing set.
+ */
+ANIMATEDTEXTURE_API void EncodeGIFBinary(const FGIFParseResult& GIF, TArray<uint8>& OutBuffer);
+
+/**
+ * LZW compress pixel indices into GIF data sub-blocks, the minimum code size byte and the block terminator included
+ * @param MinCodeSize	bits per pixel index, 2..8
+ */
+void EncodeGIFImageData(const uint8* Indices, uint32 Count, uint8 MinCodeSize, TArray<uint8>& OutBuffer);
@@ -0,0 +1,115 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "BCEncoder.h"
+
+#include "Math/RandomStream.h"	// Core
+#include "Misc/AutomationTest.h"	// Core
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** The benchmark commandlet holds composed GIF frames to the same floor */
+static const double MinBlockPSNR = 24.0;
+
+/** Smooth gradients with some noise, alpha on or off per pixel as GIF frames have it */
+static void BuildTestImage(uint32 Width, uint32 Height, bool bTransparent, TArray<FColor>& OutPixels)
+{
+	FRandomStream Random(Width * 31 + Height);
+	OutPixels.SetNumUninitialized(Width * Height);
+	for (uint32 y = 0; y < Height; y++)
+	{
+		for (uint32 x = 0; x < Width; x++)
+		{
+			const int32 Noise = Random.RandRange(-8, 8);
+			FColor& Pixel = OutPixels[y * Width + x];
+			Pixel.R = (uint8)FMath::Clamp<int32>(x * 255 / Width + Noise, 0, 255);
+			Pixel.G = (uint8)FMath::Clamp<int32>(y * 255 / Height - Noise, 0, 255);
+			Pixel.B = (uint8)FMath::Clamp<int32>((x + y) * 127 / (Width + Height) + 64 + Noise, 0, 255);
+			Pixel.A = bTransparent && ((x / 3 + y / 5) % 2 == 0) ? 0 : 255;
+		}// end of for
+	}// end of for
+}
+
+/** Encode and decode an image, @return false with an error logged if it lost too much */
+static bool TestBlockRoundTrip(FAutomationTestBase& Test, uint32 Width, uint32 Height, EPixelFormat Format)
+{
+	const TCHAR* FormatName = Format == PF_DXT5 ? TEXT("BC3") : TEXT("BC1");
+
+	TArray<FColor> Pixels;
+	BuildTestImage(Width, Height, Format == PF_DXT5, Pixels);
+
+	TArray<uint8> Blocks;
+	Blocks.SetNumZeroed(GetBCImageSize(Width, Height, Format));
+	if (Blocks.Num() != (int32)(((Width + 3) / 4) * ((Height + 3) / 4) * GetBCBlockBytes(Format)))
+	{
+		Test.AddError(FString::Printf(TEXT("%s %ux%u: image size %d does not match its blocks"), FormatName, Width, Height, Blocks.Num()));
+		return false;
+	}
+
+	TArray<FColor> Decoded;
+	Decoded.SetNumZeroed(Width * Height);
+	EncodeBCImage(Pixels.GetData(), Width, Height, Format, Blocks.GetData());
+	DecodeBCImage(Blocks.GetData(), Width, Height, Format, Decoded.GetData());
+
+	double SquaredError = 0.0;
+	int32 MaxAlphaError = 0;
+	for (int32 p = 0; p < Pixels.Num(); p++)
+	{
+		const FColor& A = Pixels[p];
+		const FColor& B = Decoded[p];
+		SquaredError += FMath::Square(A.R - B.R) + FMath::Square(A.G - B.G) + FMath::Square(A.B - B.B);
+		// BC1 has no alpha, it decodes opaque
+		MaxAlphaError = FMath::Max(MaxAlphaError, FMath::Abs((Format == PF_DXT5 ? A.A : 255) - B.A));
+	}// end of for
+
+	const double MeanSquaredError = SquaredError / ((double)Width * Height * 3);
+	const double PSNR = MeanSquaredError > 0.0 ? 10.0 * FMath::LogX(10.0, 255.0 * 255.0 / MeanSquaredError) : 99.0;
+	if (PSNR < MinBlockPSNR || MaxAlphaError > 0)
+	{
+		Test.AddError(FString::Printf(TEXT("%s %ux%u: %.2f dB, alpha off by %d"), FormatName, Width, Height, PSNR, MaxAlphaError));
+		return false;
+	}
+	return true;
+}
+
+/** A block of one color comes back as the nearest 5:6:5 color */
+static bool TestSolidBlock(FAutomationTestBase& Test, EPixelFormat Format)
+{
+	const FColor Color(255, 0, 255, Format == PF_DXT5 ? 128 : 255);
+	TArray<FColor> Pixels;
+	Pixels.Init(Color, 4 * 4);
+
+	TArray<uint8> Blocks;
+	Blocks.SetNumZeroed(GetBCBlockBytes(Format));
+	TArray<FColor> Decoded;
+	Decoded.SetNumZeroed(4 * 4);
+	EncodeBCImage(Pixels.GetData(), 4, 4, Format, Blocks.GetData());
+	DecodeBCImage(Blocks.GetData(), 4, 4, Format, Decoded.GetData());
+
+	for (const FColor& Pixel : Decoded)
+	{
+		if (Pixel != Color)
+		{
+			Test.AddError(FString::Printf(TEXT("%s solid block: %s decoded as %s"), Format == PF_DXT5 ? TEXT("BC3") : TEXT("BC1"), *Color.ToString(), *Pixel.ToString()));
+			return false;
+		}
+	}// end of for
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnimatedTextureBCEncoderTest, "Plugins.AnimatedTexture.BCEncoder.RoundTrip", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnimatedTextureBCEncoderTest::RunTest(const FString& Parameters)
+{
+	bool bSucceeded = true;
+	for (EPixelFormat Format : { PF_DXT1, PF_DXT5 })
+	{
+		bSucceeded &= TestSolidBlock(*this, Format);
+		bSucceeded &= TestBlockRoundTrip(*this, 64, 64, Format);
+		// partial blocks on the right and bottom edges
+		bSucceeded &= TestBlockRoundTrip(*this, 37, 21, Format);
+		bSucceeded &= TestBlockRoundTrip(*this, 1, 1, Format);
+	}// end of for
+	return bSucceeded;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -14,12 +14,32 @@
 #include "CoreMinimal.h"
 #include "Tickable.h"	// Engine
 #include "Engine/Texture.h"	// Engine
+#include "Serialization/BulkData.h"	// Core
 
 #include "AnimatedTexture2D.generated.h"
 
 class FAnimatedTextureResource;
+class FAnimatedTextureFrameCache;
+class UAnimatedTexturePlayer;
+class FGIFParseTask;
+struct FGIFParseResult;
+template<typename TTask> class FAsyncTask;
 ANIMATEDTEXTURE_API bool isGifData(const void* data);
 
+/** palettes are stored with 256 colors whatever the GIF declares, so any pixel index is valid */
+static const int32 GIF_PALETTE_COLORS = 256;
+
+UENUM()
+enum class EAnimatedTextureUploadMode : uint8
+{
+	/** Pre-upload small animations, see r.AnimatedTexture.PreUploadMaxBytes and r.AnimatedTexture.PreUploadMaxFrames */
+	Auto,
+	/** Compose each frame when it is shown and upload the area that changed */
+	Streaming,
+	/** Compose every frame once into its own texture, playback only switches between them */
+	PreUploadAllFrames,
+};
+
 USTRUCT()
 struct FGIFFrame
 {
@@ -46,11 +66,15 @@ public:
 	UPROPERTY()
 		TArray<uint8> PixelIndices;	// pixel indices for the current frame
 	UPROPERTY()
-		TArray<FColor> Palette;	// the current palette
+		int32 PaletteIndex;	// palette in UAnimatedTexture2D::Palettes, shared by frames with the same colors
+	UPROPERTY()
+		uint32 DataOffset;	// byte offset of the image descriptor in the GIF file, used to decode on demand
 
 	FGIFFrame() :Time(0), Index(0), Width(0), Height(0), OffsetX(0), OffsetY(0),
-		Interlacing(false), Mode(0), TransparentIndex(-1)
+		Interlacing(false), Mode(0), TransparentIndex(-1), PaletteIndex(0), DataOffset(0)
 	{}
+
+	friend ANIMATEDTEXTURE_API FArchive& operator<<(FArchive& Ar, FGIFFrame& Frame);
 };
 
 
@@ -62,8 +86,12 @@ class ANIMATEDTEXTURE_API UAnimatedTexture2D : public UTexture
 {
 	GENERATED_BODY()
 
+	// loads and releases the GIF data while the texture waits for it
+	friend class FGIFParseTask;
+
 public:
 	friend FAnimatedTextureResource;
+	friend class FAnimatedTextureCompositor;
 
 	UAnimatedTexture2D(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
@@ -79,19 +107,62 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AnimatedTexture)
 		float DefaultFrameDelay = 1.0f / 10;	// used while Frame.Delay==0
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AnimatedTexture)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetPlayRate, Category = AnimatedTexture)
 		float PlayRate = 1.0f;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AnimatedTexture)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetLooping, Category = AnimatedTexture)
 		bool bLooping = true;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AnimatedTexture)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetAlwaysTickEvenNoSee, Category = AnimatedTexture)
 		bool bAlwaysTickEvenNoSee = false;
 
+	/** Most frame changes per second, frames in between are skipped but playback keeps its speed. 0 shows every frame */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetMaxUpdateRate, Category = AnimatedTexture, meta = (ClampMin = "0"))
+		float MaxUpdateRate = 0.0f;
+
+	/** Cook the decoded frame table and strip the GIF file, so cooked loads skip the GIF decoding */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay)
+		bool bCookDecodedFrames = true;
+
+	/**
+	 * Compose every frame at cook time and store it block compressed, BC1 for opaque GIFs and BC3 for transparent ones.
+	 * Playback uploads the blocks as they are, with no composing on the CPU, and needs 4 to 8 times less upload and GPU memory.
+	 * Requires a width and height multiple of 4, ignored otherwise
+	 */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay)
+		bool bCookCompressedFrames = false;
+
+	/** Keep only the compressed GIF in memory and decode each frame right before it is drawn */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay)
+		bool bDecodeFramesOnDemand = false;
+
+	/** Trade GPU memory for CPU time: pre-uploaded frames cost no composing or upload while playing */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay)
+		EAnimatedTextureUploadMode UploadMode = EAnimatedTextureUploadMode::Auto;
+
+	/** Box filter a full mip chain of each frame on the CPU, for textures seen from a distance. Only the area a frame changed is filtered again */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay)
+		bool bGenerateMips = false;
+
+	/**
+	 * Textures the frames are written to in turn, the one sampled is swapped through the texture reference.
+	 * A frame goes to the next texture once a GPU fence shows no frame in flight reads it, otherwise it is written in place.
+	 * 1 always writes in place, 3 keeps up when the GPU renders two frames behind. Each extra texture costs its memory again
+	 */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay, meta = (ClampMin = "1", ClampMax = "3"))
+		int32 TextureBufferCount = 1;
+
+	/** Snapshot the composed canvas every N frames while playing, so a seek replays at most N-1 frames. 0 disables the snapshots */
+	UPROPERTY(EditAnywhere, Category = AnimatedTexture, AdvancedDisplay, meta = (ClampMin = "0"))
+		int32 KeyframeInterval = 0;
+
 	UPROPERTY(VisibleAnywhere, Transient,Category = AnimatedTexture)
 		int FrameNum;
 
 
+	virtual void Serialize(FArchive& Ar) override;
+
+
 	virtual void PostLoad() override;
 
 
@@ -100,6 +171,15 @@ public:
 
 	bool ImportGIF(const uint8* Buffer, uint32 BufferSize);
 
+	/**
+	 * Parse a GIF file without touching any UObject, so many files can be parsed on worker threads
+	 * @return nullptr if the file can not be parsed
+	 */
+	static TSharedPtr<FGIFParseResult> ParseGIF(const uint8* Buffer, uint32 BufferSize);
+
+	/** ImportGIF with the result of ParseGIF, Buffer is the file it was parsed from. The frames are moved out of Parsed */
+	void ImportParsedGIF(const uint8* Buffer, uint32 BufferSize, const TSharedRef<FGIFParseResult>& Parsed);
+
 	void ResetToInVaildGif()
 	{
 		GlobalWidth = 0;
@@ -107,11 +187,12 @@ public:
 		Background = 0;
 		Duration = 0.0f;
 		Frames.Empty();
+		Palettes.Empty();
+		FrameStartTimes.Empty();
+		FrameCache.Reset();
 		FrameNum = 0;
 	}
 
-	void Import_Init(uint32 InGlobalWidth, uint32 InGlobalHeight, uint8 InBackground, uint32 InFrameCount);
-
 	int GetFrameCount() const
 	{ 
 		return Frames.Num(); 
@@ -129,13 +210,127 @@ public:
 
 	float GetTotalDuration() const { return Duration; }
 
+	/** Time from the start of the animation to the start of a frame, frames without delay last DefaultFrameDelay */
+	float GetFrameStartTime(int32 FrameIndex) const { return FrameStartTimes[FrameIndex]; }
+
+	/** Time to play every frame once, frames without delay last DefaultFrameDelay */
+	float GetPlaybackLength() const { return FrameStartTimes.Num() > 0 ? FrameStartTimes.Last() : 0.0f; }
+
+	/**
+	 * Frame shown Time seconds after the start of the animation, Time must be in [0, GetPlaybackLength())
+	 * @param OutFrameTime	time already spent on the returned frame
+	 */
+	int32 FindFrameAtTime(float Time, float& OutFrameTime) const;
+
+	/** Frame shown Time seconds after playback started, Time is wrapped or clamped to the animation */
+	int32 FindPlaybackFrame(float Time, bool bInLooping, float& OutFrameTime) const;
+
+	/** Render thread data shared by every resource playing the current frames */
+	const TSharedPtr<FAnimatedTextureFrameCache, ESPMode::ThreadSafe>& GetFrameCache() const { return FrameCache; }
+
+	/** GIF_PALETTE_COLORS colors, the transparent one already has zero alpha */
+	const FColor* GetPalette(const FGIFFrame& Frame) const
+	{
+		return Palettes.GetData() + Frame.PaletteIndex * GIF_PALETTE_COLORS;
+	}
+
+	/**
+	 * Pixel indices of a frame, decoded from the GIF file into Scratch when the frame does not keep them
+	 * @return nullptr if the frame can not be decoded
+	 */
+	const uint8* GetFramePixels(const FGIFFrame& Frame, TArray<uint8>& Scratch) const;
+
+	/** Bytes of the decoded pixel indices kept by the frames, outside the editor they are handed over to the frame cache */
+	SIZE_T GetFramePixelsSize() const;
+
+	/** Bytes of the GIF file in memory, resident only while it is parsed or to decode frames again */
+	SIZE_T GetGIFDataSize() const;
+
+	/** Bytes of the block compressed frames in memory */
+	SIZE_T GetCompressedFramesSize() const { return HasCompressedFrames() ? ResidentCompressedFramesSize : 0; }
+
+	SIZE_T GetPalettesSize() const { return Palettes.GetAllocatedSize(); }
+
+	/**
+	 * Make the GIF file resident so the memory budget may free the frame pixels in the frame cache,
+	 * frames are decoded from the file right before they are drawn from then on.
+	 * Game thread, asked for by the render thread when the budget is exceeded
+	 */
+	void AllowFramePixelsEviction();
+
+	/** Color shown where no frame has been drawn, also used while the frames are parsed */
+	FColor GetBackgroundColor() const;
+
+	/** True if the frames were composed and block compressed at cook time, see bCookCompressedFrames */
+	bool HasCompressedFrames() const { return ResidentCompressedFrames.IsValid(); }
+
+	/** PF_DXT1 or PF_DXT5 when HasCompressedFrames */
+	EPixelFormat GetCompressedFormat() const { return (EPixelFormat)CompressedFormat; }
+
+	/** Blocks of every mip of a composed frame, mip 0 first */
+	const uint8* GetCompressedFrame(int32 FrameIndex) const;
+
+	/** Bytes of one compressed frame, all its mips included */
+	uint32 GetCompressedFrameSize() const;
+
+	/** Mips of the textures the frames are played into, 1 unless bGenerateMips */
+	int32 GetCanvasMipCount() const;
+
+	/** Textures written in turn while playing, see TextureBufferCount. 1 for pre-uploaded frames, which are never written */
+	int32 GetTextureBufferCount() const;
+
+	/** True if every frame gets its own texture, picked by UploadMode */
+	bool UsesPreUploadedFrames() const;
+
+	/** Pick up the result of the async parse started in PostLoad, waits for it if necessary */
+	void FinishAsyncParse();
+
+	/** Players showing this texture, their resources are told about or rebuilt with new frames as the texture's own is */
+	void RegisterPlayer(UAnimatedTexturePlayer* Player);
 
 	void Import_Finished();
 
 	void PostInitProperties() override;
 
 private:
-	bool ParseRawData();
+	bool ReadGIFHeader();
+	bool ParseGIFData();
+	void ParseGIFDataAsync();
+
+	/** Replace the GIF file, the only copy of Buffer the texture makes */
+	void SetGIFData(const uint8* Buffer, uint32 BufferSize);
+
+	/** Load bulk data into resident memory if it is not there yet, game thread unless the task parsing it owns it */
+	static void AcquireBulkData(FByteBulkData& BulkData, TUniquePtr<FOwnedBulkDataPtr>& OutResident, int32& OutResidentSize);
+	void ReleaseGIFData();
+	bool KeepsGIFData() const;
+	const uint8* GetResidentGIF() const { return ResidentGIF.IsValid() ? (const uint8*)ResidentGIF->GetPointer() : nullptr; }
+	void ApplyParseResult(FGIFParseResult& Result);
+
+	/** New frame cache for the current frames, outside the editor it takes their pixel indices */
+	void CreateFrameCache();
+
+	/** Player resources read Frames on the render thread, release them before Frames is replaced and recreate them after */
+	TArray<UAnimatedTexturePlayer*> ReleasePlayerResources();
+	static void RecreatePlayerResources(const TArray<UAnimatedTexturePlayer*>& ReleasedPlayers);
+	void SeekInternal(int32 FrameIndex, float FrameTime);
+
+	/** The render thread keeps its own copy of the playback properties, setters send it over */
+	void UpdatePlaybackSettings();
+	void BuildFrameStartTimes();
+
+	void SerializeFrameData(FArchive& Ar);
+	void SerializeGIFData(FArchive& Ar);
+	void SerializeCompressedFrames(FArchive& Ar);
+
+#if WITH_EDITOR
+	/**
+	 * Compose every frame at full size and block compress it with its mips into CompressedFrameData,
+	 * fetched from the derived data cache when an earlier cook built the same frames
+	 * @return false if the texture can not be block compressed, or the target platform can not sample BC1/BC3
+	 */
+	bool BuildCompressedFrames(const ITargetPlatform* TargetPlatform);
+#endif // WITH_EDITOR
 
 public:
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
@@ -147,21 +342,42 @@ public:
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
 		void Stop();
 
+	/** Show a frame, the canvas is rebuilt from the nearest keyframe */
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SeekToFrame(int32 FrameIndex);
+
+	/** Show the frame playing at Time seconds, wrapped into the animation length when looping */
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SeekToTime(float Time);
+
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
 		bool IsPlaying() const { return bPlaying; }
 
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
-		void SetLooping(bool bNewLooping) { bLooping = bNewLooping; }
+		void SetLooping(bool bNewLooping);
 
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
 		bool IsLooping() const { return bLooping; }
 
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
-		void SetPlayRate(float NewRate) { PlayRate = NewRate; }
+		void SetPlayRate(float NewRate);
 
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
 		float GetPlayRate() const { return PlayRate; }
 
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetAlwaysTickEvenNoSee(bool bNewAlwaysTick);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetMaxUpdateRate(float NewMaxUpdateRate);
+
+	/**
+	 * Tell how large the texture is drawn, in pixels along its longer side, e.g. from the widget or the projected mesh bounds.
+	 * Textures drawn smaller than their own size update less often and yield to larger ones when uploads are limited
+	 */
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void ReportScreenSize(float ScreenSize);
+
 	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
 		float GetAnimationLength() const;
 
@@ -180,6 +396,8 @@ public:
 	//~ Begin UObject Interface.
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual void ClearCachedCookedPlatformData(const ITargetPlatform* TargetPlatform) override;
+	virtual void ClearAllCachedCookedPlatformData() override;
 #endif // WITH_EDITOR
 	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
 	
@@ -203,6 +421,38 @@ private:
 	//UPROPERTY()
 	TArray<FGIFFrame> Frames;
 
+	// deduplicated final palettes, GIF_PALETTE_COLORS colors each
+	TArray<FColor> Palettes;
+
+	// prefix sum of the frame delays, Frames.Num()+1 entries
+	TArray<float> FrameStartTimes;
+
+	// replaced whenever Frames changes, resources keep the one matching their frames
+	TSharedPtr<FAnimatedTextureFrameCache, ESPMode::ThreadSafe> FrameCache;
+
+	// players that created a resource with this texture as their source, see RegisterPlayer
+	TArray<TWeakObjectPtr<UAnimatedTexturePlayer>> Players;
+
+	// GIF file of packages saved before FAnimatedTextureCustomVersion::GIFBulkData, moved into GIFData on load
 	UPROPERTY()
 	TArray<uint8> RawData;
+
+	// the GIF file, loaded from disk only to be parsed or kept resident to decode frames on demand
+	FByteBulkData GIFData;
+
+	// logical screen descriptor and global palette, size and background color are known before GIFData is loaded
+	TArray<uint8> GIFHeader;
+
+	// GIFData made resident, memory mapped from the cooked package when the platform allows
+	TUniquePtr<FOwnedBulkDataPtr> ResidentGIF;
+	int32 ResidentGIFSize = 0;
+
+	// every frame composed and block compressed by the cook, see bCookCompressedFrames
+	FByteBulkData CompressedFrameData;
+	TUniquePtr<FOwnedBulkDataPtr> ResidentCompressedFrames;
+	int32 ResidentCompressedFramesSize = 0;
+	uint8 CompressedFormat = PF_Unknown;	// EPixelFormat
+	int32 CompressedMipCount = 0;
+
+	FAsyncTask<FGIFParseTask>* AsyncParseTask = nullptr;
 };
\ No newline at end of file
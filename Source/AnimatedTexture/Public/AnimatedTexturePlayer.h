@@ -0,0 +1,126 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/Texture.h"	// Engine
+
+#include "AnimatedTexturePlayer.generated.h"
+
+class UAnimatedTexture2D;
+
+/**
+ * A texture playing the frames of a UAnimatedTexture2D with its own playhead.
+ * Frames, palettes and keyframes stay in the source, a player only adds a canvas and one RHI texture,
+ * so many unsynchronized copies of one GIF do not duplicate the asset.
+ */
+UCLASS(BlueprintType, Category = AnimatedTexture, hideCategories = (Adjustments, Compression, LevelOfDetail))
+class ANIMATEDTEXTURE_API UAnimatedTexturePlayer : public UTexture
+{
+	GENERATED_BODY()
+
+public:
+	UAnimatedTexturePlayer(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** New transient player of Source, use it as a texture parameter of a dynamic material instance */
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		static UAnimatedTexturePlayer* CreateAnimatedTexturePlayer(UAnimatedTexture2D* InSource);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetSource, Category = AnimatedTexture)
+		UAnimatedTexture2D* Source;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetPlayRate, Category = AnimatedTexture)
+		float PlayRate = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetLooping, Category = AnimatedTexture)
+		bool bLooping = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetAlwaysTickEvenNoSee, Category = AnimatedTexture)
+		bool bAlwaysTickEvenNoSee = false;
+
+	/** Most frame changes per second, frames in between are skipped but playback keeps its speed. 0 shows every frame */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetMaxUpdateRate, Category = AnimatedTexture, meta = (ClampMin = "0"))
+		float MaxUpdateRate = 0.0f;
+
+public:
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetSource(UAnimatedTexture2D* NewSource);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void Play();
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void PlayFromStart();
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void Stop();
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		bool IsPlaying() const { return bPlaying; }
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SeekToFrame(int32 FrameIndex);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SeekToTime(float Time);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetLooping(bool bNewLooping);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		bool IsLooping() const { return bLooping; }
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetPlayRate(float NewRate);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		float GetPlayRate() const { return PlayRate; }
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetAlwaysTickEvenNoSee(bool bNewAlwaysTick);
+
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void SetMaxUpdateRate(float NewMaxUpdateRate);
+
+	/**
+	 * Tell how large the texture is drawn, in pixels along its longer side, e.g. from the widget or the projected mesh bounds.
+	 * Textures drawn smaller than their own size update less often and yield to larger ones when uploads are limited
+	 */
+	UFUNCTION(BlueprintCallable, Category = AnimatedTexture)
+		void ReportScreenSize(float ScreenSize);
+
+	//~ Begin UTexture Interface.
+	virtual float GetSurfaceWidth() const override;
+	virtual float GetSurfaceHeight() const override;
+	virtual FTextureResource* CreateResource() override;
+	virtual EMaterialValueType GetMaterialType() const override { return MCT_Texture2D; }
+	virtual uint32 CalcTextureMemorySizeEnum(ETextureMipCount Enum) const override;
+	//~ End UTexture Interface.
+
+	//~ Begin UObject Interface.
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif // WITH_EDITOR
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+	//~ End UObject Interface.
+
+private:
+	/** Sampling follows the source texture */
+	void CopySourceSettings();
+
+	void UpdatePlaybackSettings();
+	void SeekInternal(int32 FrameIndex, float FrameTime);
+
+protected:
+	UPROPERTY()
+		bool bPlaying = true;
+};
@@ -1,5 +1,6 @@
 // Copyright 2019 Neil Fang. All Rights Reserved.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class AnimatedTextureEditor : ModuleRules
@@ -17,6 +18,8 @@ public class AnimatedTextureEditor : ModuleRules
 		
 		PrivateIncludePaths.AddRange(
 			new string[] {
+				// the benchmark commandlet measures the decoder, compositor and block encoder directly
+				Path.Combine(ModuleDirectory, "../AnimatedTexture/Private"),
 				// ... add other private include paths required here ...
 			}
 			);
@@ -37,8 +40,10 @@ public class AnimatedTextureEditor : ModuleRules
 				"CoreUObject",
 				"Engine",
 				"UnrealEd",
+				"AssetRegistry",
                 "RHI",
                 "RenderCore",
+                "Projects",
             }
 			);
 		
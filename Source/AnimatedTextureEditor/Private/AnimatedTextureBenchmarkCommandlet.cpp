@@ -0,0 +1,417 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "AnimatedTextureBenchmarkCommandlet.h"
+#include "AnimatedTextureEditorModule.h"
+#include "AnimatedTexture2D.h"
+
+// internals of the AnimatedTexture module, see AnimatedTextureEditor.Build.cs
+#include "AnimatedTextureCompositor.h"
+#include "AnimatedTextureKernels.h"
+#include "BCEncoder.h"
+#include "GIFDecoder.h"
+#include "GIFEncoder.h"
+
+#include "HAL/PlatformTime.h"	// Core
+#include "Math/RandomStream.h"	// Core
+#include "Misc/DateTime.h"	// Core
+#include "Misc/EngineVersion.h"	// Core
+#include "Misc/FileHelper.h"	// Core
+#include "Misc/Parse.h"	// Core
+#include "Misc/Paths.h"	// Core
+#include "UObject/Package.h"	// CoreUObject
+#include "Interfaces/IPluginManager.h"	// Projects
+
+/** One GIF of the generated corpus */
+struct FAnimatedTextureBenchmarkCase
+{
+	const TCHAR* Name;
+	uint32 Width;
+	uint32 Height;
+	int32 NumFrames;
+	bool bPartialFrames;	// frames cover a moving quarter of the canvas instead of all of it
+	bool bLocalPalettes;
+	bool bInterlaced;
+	EGIF_Mode Mode;
+	bool bTransparent;	// half the pixels of each frame show the one below
+};
+
+static const FAnimatedTextureBenchmarkCase BenchmarkCases[] =
+{
+	// Name						Width	Height	Frames	Partial	Local	Interl.	Mode		Transparent
+	{ TEXT("small_global"),		64,		64,		32,		false,	false,	false,	GIF_NONE,	false },
+	{ TEXT("small_local"),		64,		64,		32,		false,	true,	false,	GIF_NONE,	false },
+	{ TEXT("large_global"),		1024,	1024,	8,		false,	false,	false,	GIF_NONE,	false },
+	{ TEXT("large_local"),		1024,	1024,	8,		false,	true,	false,	GIF_NONE,	false },
+	{ TEXT("interlaced"),		512,	512,	16,		false,	false,	true,	GIF_NONE,	false },
+	{ TEXT("dispose_none"),		512,	512,	24,		true,	false,	false,	GIF_NONE,	false },
+	{ TEXT("dispose_keep"),		512,	512,	24,		true,	false,	false,	GIF_CURR,	false },
+	{ TEXT("dispose_background"),	512,	512,	24,		true,	false,	false,	GIF_BKGD,	false },
+	{ TEXT("dispose_previous"),	512,	512,	24,		true,	false,	false,	GIF_PREV,	false },
+	{ TEXT("transparent_delta"),	512,	512,	24,		true,	false,	false,	GIF_CURR,	true },
+};
+
+/** What one case measured */
+struct FAnimatedTextureBenchmarkResult
+{
+	FString Name;
+	uint32 Width = 0;
+	uint32 Height = 0;
+	int32 NumFrames = 0;
+	int32 GIFBytes = 0;
+	double ParseMBps = 0.0;	// LoadGIFBinary, every frame decoded
+	double ScanMBps = 0.0;	// ScanGIFBinary, frame table only
+	double LZWMBps = 0.0;	// DecodeGIFFrame on every frame, MB of GIF per second
+	double ReferenceLZWMBps = 0.0;	// same with the LZW decoder of gif_load
+	double CompositeFPS = 0.0;	// frames drawn per second from decoded pixel indices
+	double OnDemandCompositeFPS = 0.0;	// same, each frame LZW decoded right before it is drawn
+	double UploadBytesPerFrame = 0.0;	// dirty rect of the canvas, what the texture receives per frame
+	EPixelFormat BlockFormat = PF_Unknown;	// what the cook picks for bCookCompressedFrames
+	double BlockEncodeMBps = 0.0;	// EncodeBCImage on every composed frame, MB of canvas per second
+	double BlockPSNR = 0.0;	// RGB of the decoded blocks against the composed frames, in dB
+	int32 BlockBytesPerFrame = 0;	// what the texture receives per frame when cooked compressed
+};
+
+/** Composed frames encoded to blocks may not lose more than this, the noise of the corpus keeps it under 30 dB */
+static const double MinBlockPSNR = 24.0;
+
+static void BuildCorpusGIF(const FAnimatedTextureBenchmarkCase& Case, FGIFParseResult& OutGIF)
+{
+	FRandomStream Random(FCrc::StrCrc32(Case.Name));
+
+	OutGIF = FGIFParseResult();
+	OutGIF.GlobalWidth = Case.Width;
+	OutGIF.GlobalHeight = Case.Height;
+	OutGIF.Background = 0;
+
+	//-- palette 0 is the global one, local palettes shift its hue a little per frame
+	const int32 NumPalette = Case.bLocalPalettes ? Case.NumFrames + 1 : 1;
+	OutGIF.Palettes.SetNumUninitialized(NumPalette * GIF_PALETTE_COLORS);
+	for (int32 p = 0; p < NumPalette; p++)
+	{
+		for (int32 i = 0; i < GIF_PALETTE_COLORS; i++)
+			OutGIF.Palettes[p * GIF_PALETTE_COLORS + i] = FColor(i, (i * 3 + p * 11) & 0xFF, 255 - i, 255);
+	}// end of for
+
+	for (int32 f = 0; f < Case.NumFrames; f++)
+	{
+		FGIFFrame& Frame = OutGIF.Frames.AddDefaulted_GetRef();
+		Frame.Index = f;
+		Frame.Time = 0.04f;
+		Frame.Mode = Case.Mode;
+		Frame.Interlacing = Case.bInterlaced;
+		Frame.PaletteIndex = Case.bLocalPalettes ? f + 1 : 0;
+		Frame.TransparentIndex = Case.bTransparent ? 0 : -1;
+
+		// the first frame always covers the canvas, like the GIF optimizers do
+		if (Case.bPartialFrames && f > 0)
+		{
+			Frame.Width = Case.Width / 2;
+			Frame.Height = Case.Height / 2;
+			Frame.OffsetX = (f * Case.Width / 8) % (Case.Width - Frame.Width + 1);
+			Frame.OffsetY = (f * Case.Height / 16) % (Case.Height - Frame.Height + 1);
+		}
+		else
+		{
+			Frame.Width = Case.Width;
+			Frame.Height = Case.Height;
+		}
+
+		//-- flat 8x8 blocks with some noise, compresses about as well as typical GIF content
+		Frame.PixelIndices.SetNumUninitialized(Frame.Width * Frame.Height);
+		uint8* Pixels = Frame.PixelIndices.GetData();
+		for (uint32 y = 0; y < Frame.Height; y++)
+		{
+			for (uint32 x = 0; x < Frame.Width; x++)
+			{
+				uint8 Index = (uint8)(((x / 8 + y / 8 + f) * 37) & 0xFF);
+				if (Random.RandHelper(10) == 0)
+					Index = (uint8)Random.RandHelper(256);
+				if (Case.bTransparent && f > 0 && ((x / 8 + y / 8) & 1))
+					Index = 0;
+				else if (Case.bTransparent && Index == 0)
+					Index = 1;
+				*Pixels++ = Index;
+			}// end of for
+		}// end of for
+	}// end of for
+}
+
+/** Run Func until MinTime has passed, @return runs per second */
+template<typename FuncType>
+static double MeasureRate(double MinTime, FuncType&& Func)
+{
+	Func();	// warm up
+
+	int64 NumRuns = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	double Elapsed = 0.0;
+	do
+	{
+		Func();
+		NumRuns++;
+		Elapsed = FPlatformTime::Seconds() - StartTime;
+	} while (Elapsed < MinTime);
+
+	return NumRuns / Elapsed;
+}
+
+/** Play the frames in a loop as FAnimatedTextureResource does, @return frames per second */
+static double MeasureComposite(UAnimatedTexture2D* Texture, double MinTime, double& OutUploadBytesPerFrame)
+{
+	const int32 NumFrame = Texture->GetFrameCount();
+	FAnimatedTextureCompositor Compositor(Texture, 0);
+	Compositor.SetFrameCache(Texture->GetFrameCache());
+	Compositor.Reset();
+
+	uint64 UploadBytes = 0;
+	auto PlayAllFrames = [&]()
+	{
+		for (int32 i = 0; i < NumFrame; i++)
+		{
+			Compositor.AdvanceTo(i);
+			Compositor.ComposeFrame(i);
+			UploadBytes += Compositor.ConsumeDirtyRect().Area() * sizeof(FColor);
+			Compositor.DisposeFrame();
+		}// end of for
+	};
+
+	// the first loop uploads the whole canvas, only the looping state counts
+	PlayAllFrames();
+	UploadBytes = 0;
+	PlayAllFrames();
+	OutUploadBytesPerFrame = (double)UploadBytes / FMath::Max(NumFrame, 1);
+
+	return MeasureRate(MinTime, PlayAllFrames) * NumFrame;
+}
+
+/** Decode every frame with both LZW decoders, @return false if their pixel indices differ */
+static bool CheckLZWDecoder(const TArray<uint8>& GIFData, const FGIFParseResult& Scanned, const TCHAR* CaseName)
+{
+	TArray<uint8> Scratch, ReferenceScratch;
+	for (const FGIFFrame& Frame : Scanned.Frames)
+	{
+		const uint8* Pixels = DecodeGIFFrame(GIFData.GetData(), GIFData.Num(), Frame, Scratch);
+		const uint8* ReferencePixels = DecodeGIFFrameReference(GIFData.GetData(), GIFData.Num(), Frame, ReferenceScratch);
+		if (Pixels == nullptr || ReferencePixels == nullptr
+			|| FMemory::Memcmp(Pixels, ReferencePixels, Frame.Width * Frame.Height) != 0)
+		{
+			UE_LOG(LogAnimTextureEditor, Error, TEXT("%s: LZW decoder differs from gif_load on frame %d"), CaseName, Frame.Index);
+			return false;
+		}
+	}// end of for
+	return true;
+}
+
+/**
+ * Block compress every composed frame as the cook does for bCookCompressedFrames and decode it back,
+ * @return false if the color error is above MinBlockPSNR or any alpha changed
+ */
+static bool CheckBlockEncoder(UAnimatedTexture2D* Texture, double MinTime, FAnimatedTextureBenchmarkResult& Result)
+{
+	const uint32 Width = Result.Width;
+	const uint32 Height = Result.Height;
+	const int32 NumFrame = Texture->GetFrameCount();
+
+	TArray<TArray<FColor>> Composed;
+	bool bTransparent = false;
+	FAnimatedTextureCompositor Compositor(Texture, 0);
+	Compositor.Reset();
+	for (int32 i = 0; i < NumFrame; i++)
+	{
+		Compositor.ComposeFrame(i);
+		Composed.Emplace(Compositor.GetCanvas(), Width * Height);
+		for (const FColor& Pixel : Composed.Last())
+			bTransparent |= Pixel.A < 255;
+		Compositor.DisposeFrame();
+	}// end of for
+
+	const EPixelFormat Format = bTransparent ? PF_DXT5 : PF_DXT1;
+	TArray<uint8> Blocks;
+	Blocks.SetNumUninitialized(GetBCImageSize(Width, Height, Format));
+	TArray<FColor> Decoded;
+	Decoded.SetNumUninitialized(Width * Height);
+
+	double SquaredError = 0.0;
+	int32 MaxAlphaError = 0;
+	for (const TArray<FColor>& Frame : Composed)
+	{
+		EncodeBCImage(Frame.GetData(), Width, Height, Format, Blocks.GetData());
+		DecodeBCImage(Blocks.GetData(), Width, Height, Format, Decoded.GetData());
+		for (uint32 p = 0; p < Width * Height; p++)
+		{
+			const FColor& A = Frame[p];
+			const FColor& B = Decoded[p];
+			SquaredError += FMath::Square(A.R - B.R) + FMath::Square(A.G - B.G) + FMath::Square(A.B - B.B);
+			if (Format == PF_DXT5)
+				MaxAlphaError = FMath::Max(MaxAlphaError, FMath::Abs(A.A - B.A));
+		}// end of for
+	}// end of for
+
+	const double MeanSquaredError = SquaredError / ((double)Width * Height * 3 * FMath::Max(NumFrame, 1));
+	Result.BlockFormat = Format;
+	Result.BlockPSNR = MeanSquaredError > 0.0 ? 10.0 * FMath::LogX(10.0, 255.0 * 255.0 / MeanSquaredError) : 99.0;
+	Result.BlockBytesPerFrame = Blocks.Num();
+	if (Result.BlockPSNR < MinBlockPSNR || MaxAlphaError > 0)
+	{
+		UE_LOG(LogAnimTextureEditor, Error, TEXT("%s: block encoder lost too much, %.2f dB, alpha off by %d"), *Result.Name, Result.BlockPSNR, MaxAlphaError);
+		return false;
+	}
+
+	const double CanvasMB = (double)Width * Height * sizeof(FColor) * NumFrame / (1024.0 * 1024.0);
+	Result.BlockEncodeMBps = CanvasMB * MeasureRate(MinTime, [&]()
+	{
+		for (const TArray<FColor>& Frame : Composed)
+			EncodeBCImage(Frame.GetData(), Width, Height, Format, Blocks.GetData());
+	});
+	return true;
+}
+
+static FString GetPluginVersion()
+{
+	TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("AnimatedTexture"));
+	return Plugin.IsValid() ? Plugin->GetDescriptor().VersionName : FString(TEXT("unknown"));
+}
+
+UAnimatedTextureBenchmarkCommandlet::UAnimatedTextureBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer /*= FObjectInitializer::Get()*/)
+	:Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UAnimatedTextureBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString Filter;
+	FParse::Value(*Params, TEXT("filter="), Filter);
+
+	float MinTime = 0.5f;
+	FParse::Value(*Params, TEXT("mintime="), MinTime);
+	MinTime = FMath::Max(MinTime, 0.01f);
+
+	FString Label;
+	FParse::Value(*Params, TEXT("label="), Label);
+
+	FString OutputPath;
+	if (!FParse::Value(*Params, TEXT("output="), OutputPath))
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("AnimatedTexture") / FString::Printf(TEXT("Benchmark-%s"), *FDateTime::Now().ToString());
+
+	UE_LOG(LogAnimTextureEditor, Display, TEXT("Animated texture benchmark, plugin %s, kernels %s"), *GetPluginVersion(), GetAnimatedTextureKernelsName());
+
+	TArray<FAnimatedTextureBenchmarkResult> Results;
+	for (const FAnimatedTextureBenchmarkCase& Case : BenchmarkCases)
+	{
+		if (!Filter.IsEmpty() && !FString(Case.Name).Contains(Filter))
+			continue;
+
+		FGIFParseResult Source;
+		BuildCorpusGIF(Case, Source);
+		TArray<uint8> GIFData;
+		EncodeGIFBinary(Source, GIFData);
+
+		FAnimatedTextureBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+		Result.Name = Case.Name;
+		Result.Width = Case.Width;
+		Result.Height = Case.Height;
+		Result.NumFrames = Case.NumFrames;
+		Result.GIFBytes = GIFData.Num();
+
+		//-- parse
+		const double GIFMB = GIFData.Num() / (1024.0 * 1024.0);
+		Result.ParseMBps = GIFMB * MeasureRate(MinTime, [&GIFData]()
+		{
+			FGIFParseResult Parsed;
+			LoadGIFBinary(Parsed, GIFData.GetData(), GIFData.Num());
+		});
+		Result.ScanMBps = GIFMB * MeasureRate(MinTime, [&GIFData]()
+		{
+			FGIFParseResult Parsed;
+			ScanGIFBinary(Parsed, GIFData.GetData(), GIFData.Num());
+		});
+
+		//-- LZW alone, checked byte for byte against gif_load first
+		FGIFParseResult Scanned;
+		ScanGIFBinary(Scanned, GIFData.GetData(), GIFData.Num());
+		if (!CheckLZWDecoder(GIFData, Scanned, Case.Name))
+			return 1;
+
+		TArray<uint8> Scratch;
+		Result.LZWMBps = GIFMB * MeasureRate(MinTime, [&GIFData, &Scanned, &Scratch]()
+		{
+			for (const FGIFFrame& Frame : Scanned.Frames)
+				DecodeGIFFrame(GIFData.GetData(), GIFData.Num(), Frame, Scratch);
+		});
+		Result.ReferenceLZWMBps = GIFMB * MeasureRate(MinTime, [&GIFData, &Scanned, &Scratch]()
+		{
+			for (const FGIFFrame& Frame : Scanned.Frames)
+				DecodeGIFFrameReference(GIFData.GetData(), GIFData.Num(), Frame, Scratch);
+		});
+
+		//-- composite
+		UAnimatedTexture2D* Texture = NewObject<UAnimatedTexture2D>(GetTransientPackage(), NAME_None, RF_Transient);
+		if (!Texture->ImportGIF(GIFData.GetData(), GIFData.Num()) || Texture->GetFrameCount() != Case.NumFrames)
+		{
+			UE_LOG(LogAnimTextureEditor, Error, TEXT("%s: generated GIF failed to load"), Case.Name);
+			return 1;
+		}
+		Result.CompositeFPS = MeasureComposite(Texture, MinTime, Result.UploadBytesPerFrame);
+
+		UAnimatedTexture2D* OnDemandTexture = NewObject<UAnimatedTexture2D>(GetTransientPackage(), NAME_None, RF_Transient);
+		OnDemandTexture->bDecodeFramesOnDemand = true;
+		OnDemandTexture->ImportGIF(GIFData.GetData(), GIFData.Num());
+		double UnusedUploadBytes = 0.0;
+		Result.OnDemandCompositeFPS = MeasureComposite(OnDemandTexture, MinTime, UnusedUploadBytes);
+
+		//-- cook-time block compression, checked against the composed frames
+		if (!CheckBlockEncoder(Texture, MinTime, Result))
+			return 1;
+
+		UE_LOG(LogAnimTextureEditor, Display, TEXT("%-20s %4ux%-4u %3d frames %8d bytes | parse %8.2f MB/s | scan %9.2f MB/s | lzw %8.2f MB/s (gif_load %8.2f) | composite %9.1f fps | on demand %9.1f fps | upload %10.0f B/frame | %s %7.2f MB/s %5.2f dB %8d B/frame"),
+			Case.Name, Case.Width, Case.Height, Case.NumFrames, Result.GIFBytes,
+			Result.ParseMBps, Result.ScanMBps, Result.LZWMBps, Result.ReferenceLZWMBps, Result.CompositeFPS, Result.OnDemandCompositeFPS, Result.UploadBytesPerFrame,
+			Result.BlockFormat == PF_DXT5 ? TEXT("BC3") : TEXT("BC1"), Result.BlockEncodeMBps, Result.BlockPSNR, Result.BlockBytesPerFrame);
+	}// end of for
+
+	//-- machine readable output
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"plugin_version\": \"%s\",\n"), *GetPluginVersion());
+	Json += FString::Printf(TEXT("\t\"label\": \"%s\",\n"), *Label.ReplaceCharWithEscapedChar());
+	Json += FString::Printf(TEXT("\t\"engine_version\": \"%s\",\n"), *FEngineVersion::Current().ToString());
+	Json += FString::Printf(TEXT("\t\"platform\": \"%s\",\n"), ANSI_TO_TCHAR(FPlatformProperties::IniPlatformName()));
+	Json += FString::Printf(TEXT("\t\"kernels\": \"%s\",\n"), GetAnimatedTextureKernelsName());
+	Json += FString::Printf(TEXT("\t\"min_time\": %.3f,\n"), MinTime);
+	Json += TEXT("\t\"cases\": [\n");
+
+	FString Csv = TEXT("name,width,height,frames,gif_bytes,parse_mbps,scan_mbps,lzw_mbps,gif_load_lzw_mbps,composite_fps,ondemand_composite_fps,upload_bytes_per_frame,bc_format,bc_encode_mbps,bc_psnr,bc_bytes_per_frame\n");
+
+	for (int32 i = 0; i < Results.Num(); i++)
+	{
+		const FAnimatedTextureBenchmarkResult& Result = Results[i];
+		const TCHAR* BlockFormatName = Result.BlockFormat == PF_DXT5 ? TEXT("BC3") : TEXT("BC1");
+		Json += FString::Printf(TEXT("\t\t{ \"name\": \"%s\", \"width\": %u, \"height\": %u, \"frames\": %d, \"gif_bytes\": %d, ")
+			TEXT("\"parse_mbps\": %.3f, \"scan_mbps\": %.3f, \"lzw_mbps\": %.3f, \"gif_load_lzw_mbps\": %.3f, \"composite_fps\": %.2f, \"ondemand_composite_fps\": %.2f, \"upload_bytes_per_frame\": %.0f, ")
+			TEXT("\"bc_format\": \"%s\", \"bc_encode_mbps\": %.3f, \"bc_psnr\": %.2f, \"bc_bytes_per_frame\": %d }%s\n"),
+			*Result.Name, Result.Width, Result.Height, Result.NumFrames, Result.GIFBytes,
+			Result.ParseMBps, Result.ScanMBps, Result.LZWMBps, Result.ReferenceLZWMBps, Result.CompositeFPS, Result.OnDemandCompositeFPS, Result.UploadBytesPerFrame,
+			BlockFormatName, Result.BlockEncodeMBps, Result.BlockPSNR, Result.BlockBytesPerFrame,
+			i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+
+		Csv += FString::Printf(TEXT("%s,%u,%u,%d,%d,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.0f,%s,%.3f,%.2f,%d\n"),
+			*Result.Name, Result.Width, Result.Height, Result.NumFrames, Result.GIFBytes,
+			Result.ParseMBps, Result.ScanMBps, Result.LZWMBps, Result.ReferenceLZWMBps, Result.CompositeFPS, Result.OnDemandCompositeFPS, Result.UploadBytesPerFrame,
+			BlockFormatName, Result.BlockEncodeMBps, Result.BlockPSNR, Result.BlockBytesPerFrame);
+	}// end of for
+	Json += TEXT("\t]\n}\n");
+
+	bool bSaved = FFileHelper::SaveStringToFile(Json, *(OutputPath + TEXT(".json")))
+		&& FFileHelper::SaveStringToFile(Csv, *(OutputPath + TEXT(".csv")));
+	if (!bSaved)
+	{
+		UE_LOG(LogAnimTextureEditor, Error, TEXT("Unable to write %s.json/.csv"), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogAnimTextureEditor, Display, TEXT("Benchmark results written to %s.json and %s.csv"), *OutputPath, *OutputPath);
+	return 0;
+}
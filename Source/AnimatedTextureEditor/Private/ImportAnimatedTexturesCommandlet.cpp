@@ -0,0 +1,271 @@
+// Copyright 2019 Neil Fang. All Rights Reserved.
+
+#include "ImportAnimatedTexturesCommandlet.h"
+#include "AnimatedTextureEditorModule.h"
+#include "AnimatedTexture2D.h"
+
+#include "HAL/FileManager.h"	// Core
+#include "HAL/PlatformTime.h"	// Core
+#include "Misc/FileHelper.h"	// Core
+#include "Misc/Paths.h"	// Core
+#include "Misc/Parse.h"	// Core
+#include "Misc/SecureHash.h"	// Core
+#include "Async/AsyncWork.h"	// Core
+#include "Async/ParallelFor.h"	// Core
+#include "Misc/PackageName.h"	// CoreUObject
+#include "UObject/Package.h"	// CoreUObject
+#include "EditorFramework/AssetImportData.h"	// Engine
+#include "AssetRegistryModule.h"	// AssetRegistry
+#include "ObjectTools.h"	// UnrealEd
+
+/** One GIF file on its way to an asset */
+struct FAnimatedTextureImportJob
+{
+	FString Filename;
+	FString PackageName;
+	TArray<uint8> Data;
+	TSharedPtr<FGIFParseResult> Parsed;
+	FMD5Hash FileHash;
+	FString Error;	// empty while the job succeeds
+
+	// sec
+	double ReadTime = 0.0;
+	double ParseTime = 0.0;
+	double CreateTime = 0.0;
+	double SaveTime = 0.0;
+};
+
+/** Reads and parses a range of jobs on worker threads, no UObject is touched */
+class FAnimatedTextureImportTask : public FNonAbandonableTask
+{
+public:
+	FAnimatedTextureImportTask(TArray<FAnimatedTextureImportJob>& InJobs, int32 InFirst, int32 InNum)
+		:Jobs(InJobs), First(InFirst), Num(InNum)
+	{}
+
+	void DoWork()
+	{
+		ParallelFor(Num, [this](int32 i)
+		{
+			ReadAndParse(Jobs[First + i]);
+		});
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FAnimatedTextureImportTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+private:
+	static void ReadAndParse(FAnimatedTextureImportJob& Job)
+	{
+		double StartTime = FPlatformTime::Seconds();
+		if (!FFileHelper::LoadFileToArray(Job.Data, *Job.Filename))
+		{
+			Job.Error = TEXT("unable to read the file");
+			return;
+		}
+
+		// AssetImportData would read the file again for it
+		FMD5 MD5;
+		MD5.Update(Job.Data.GetData(), Job.Data.Num());
+		Job.FileHash.Set(MD5);
+		Job.ReadTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		Job.Parsed = UAnimatedTexture2D::ParseGIF(Job.Data.GetData(), Job.Data.Num());
+		Job.ParseTime = FPlatformTime::Seconds() - StartTime;
+
+		if (!Job.Parsed.IsValid())
+		{
+			Job.Error = TEXT("not a valid GIF file");
+			Job.Data.Empty();
+		}
+	}
+
+	TArray<FAnimatedTextureImportJob>& Jobs;
+	int32 First;
+	int32 Num;
+};
+
+/** Game thread part of a job: create or overwrite the asset and save its package */
+static void CreateAsset(FAnimatedTextureImportJob& Job)
+{
+	double StartTime = FPlatformTime::Seconds();
+	const FString AssetName = FPackageName::GetLongPackageAssetName(Job.PackageName);
+
+	UPackage* Package = nullptr;
+	if (FPackageName::DoesPackageExist(Job.PackageName))
+		Package = LoadPackage(nullptr, *Job.PackageName, LOAD_None);
+	if (Package == nullptr)
+		Package = CreatePackage(nullptr, *Job.PackageName);
+	if (Package == nullptr)
+	{
+		Job.Error = TEXT("unable to create the package");
+		return;
+	}
+
+	UAnimatedTexture2D* Texture = FindObject<UAnimatedTexture2D>(Package, *AssetName);
+	const bool bCreated = Texture == nullptr;
+	if (bCreated)
+	{
+		if (FindObject<UObject>(Package, *AssetName))
+		{
+			Job.Error = TEXT("another kind of asset has the same name");
+			return;
+		}
+		Texture = NewObject<UAnimatedTexture2D>(Package, *AssetName, RF_Public | RF_Standalone | RF_Transactional);
+	}
+
+	Texture->ImportParsedGIF(Job.Data.GetData(), Job.Data.Num(), Job.Parsed.ToSharedRef());
+	Job.Parsed.Reset();
+	Job.Data.Empty();
+	Texture->AssetImportData->Update(Job.Filename, &Job.FileHash);
+	Texture->PostEditChange();
+
+	if (bCreated)
+		FAssetRegistryModule::AssetCreated(Texture);
+	Package->MarkPackageDirty();
+	Job.CreateTime = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	const FString PackageFilename = FPackageName::LongPackageNameToFilename(Job.PackageName, FPackageName::GetAssetPackageExtension());
+	if (!UPackage::SavePackage(Package, Texture, RF_Public | RF_Standalone, *PackageFilename, GError, nullptr, false, true, SAVE_NoError))
+		Job.Error = FString::Printf(TEXT("unable to save %s"), *PackageFilename);
+	Job.SaveTime = FPlatformTime::Seconds() - StartTime;
+}
+
+UImportAnimatedTexturesCommandlet::UImportAnimatedTexturesCommandlet(const FObjectInitializer& ObjectInitializer /*= FObjectInitializer::Get()*/)
+	:Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UImportAnimatedTexturesCommandlet::Main(const FString& Params)
+{
+	FString SourceDir;
+	FString DestPath;
+	if (!FParse::Value(*Params, TEXT("source="), SourceDir) || !FParse::Value(*Params, TEXT("dest="), DestPath))
+	{
+		UE_LOG(LogAnimTextureEditor, Error, TEXT("Usage: -run=ImportAnimatedTextures -source=<dir> -dest=/Game/<path> [-norecursive] [-batch=<files>] [-report=<csv>]"));
+		return 1;
+	}
+
+	FPaths::NormalizeDirectoryName(SourceDir);
+	FPaths::NormalizeDirectoryName(DestPath);
+	if (!FPackageName::IsValidLongPackageName(DestPath / TEXT("Asset")))
+	{
+		UE_LOG(LogAnimTextureEditor, Error, TEXT("%s is not a valid content path, e.g. /Game/GIF"), *DestPath);
+		return 1;
+	}
+
+	int32 BatchSize = 64;
+	FParse::Value(*Params, TEXT("batch="), BatchSize);
+	BatchSize = FMath::Max(BatchSize, 1);
+
+	FString ReportPath;
+	FParse::Value(*Params, TEXT("report="), ReportPath);
+
+	//-- find the files, their folders relative to source become folders of dest
+	TArray<FString> Files;
+	if (FParse::Param(*Params, TEXT("norecursive")))
+	{
+		IFileManager::Get().FindFiles(Files, *(SourceDir / TEXT("*.gif")), true, false);
+		for (FString& File : Files)
+			File = SourceDir / File;
+	}
+	else
+	{
+		IFileManager::Get().FindFilesRecursive(Files, *SourceDir, TEXT("*.gif"), true, false);
+	}
+	Files.Sort();
+
+	TArray<FAnimatedTextureImportJob> Jobs;
+	Jobs.SetNum(Files.Num());
+	for (int32 i = 0; i < Files.Num(); i++)
+	{
+		FString RelativeDir = FPaths::GetPath(Files[i]);
+		FPaths::MakePathRelativeTo(RelativeDir, *(SourceDir + TEXT("/")));
+
+		FString PackagePath = DestPath;
+		TArray<FString> Folders;
+		RelativeDir.ParseIntoArray(Folders, TEXT("/"));
+		for (const FString& Folder : Folders)
+		{
+			if (Folder != TEXT("."))
+				PackagePath /= ObjectTools::SanitizeObjectName(Folder);
+		}// end of for
+
+		Jobs[i].Filename = Files[i];
+		Jobs[i].PackageName = PackagePath / ObjectTools::SanitizeObjectName(FPaths::GetBaseFilename(Files[i]));
+	}// end of for
+
+	UE_LOG(LogAnimTextureEditor, Display, TEXT("Importing %d GIF files from %s to %s"), Jobs.Num(), *SourceDir, *DestPath);
+	const double StartTime = FPlatformTime::Seconds();
+
+	//-- workers parse the next batch while the game thread saves the current one
+	TUniquePtr<FAsyncTask<FAnimatedTextureImportTask>> PendingTask;
+	auto StartBatch = [&Jobs, &PendingTask, BatchSize](int32 First)
+	{
+		if (First >= Jobs.Num())
+			return;
+		PendingTask = MakeUnique<FAsyncTask<FAnimatedTextureImportTask>>(Jobs, First, FMath::Min(BatchSize, Jobs.Num() - First));
+		PendingTask->StartBackgroundTask();
+	};
+
+	int32 NumFailed = 0;
+	StartBatch(0);
+	for (int32 First = 0; First < Jobs.Num(); First += BatchSize)
+	{
+		PendingTask->EnsureCompletion();
+		PendingTask.Reset();
+		StartBatch(First + BatchSize);
+
+		const int32 Last = FMath::Min(First + BatchSize, Jobs.Num());
+		for (int32 i = First; i < Last; i++)
+		{
+			FAnimatedTextureImportJob& Job = Jobs[i];
+			if (Job.Error.IsEmpty())
+				CreateAsset(Job);
+
+			if (Job.Error.IsEmpty())
+			{
+				UE_LOG(LogAnimTextureEditor, Display, TEXT("Imported %s -> %s, read %.1f ms, parse %.1f ms, create %.1f ms, save %.1f ms"),
+					*Job.Filename, *Job.PackageName, Job.ReadTime * 1000.0, Job.ParseTime * 1000.0, Job.CreateTime * 1000.0, Job.SaveTime * 1000.0);
+			}
+			else
+			{
+				UE_LOG(LogAnimTextureEditor, Error, TEXT("Import GIF FAILED, %s: %s"), *Job.Filename, *Job.Error);
+				NumFailed++;
+			}
+
+			Job.Data.Empty();
+			Job.Parsed.Reset();
+		}// end of for
+
+		// saved packages are not needed anymore
+		CollectGarbage(RF_NoFlags);
+	}// end of for
+
+	const double TotalTime = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogAnimTextureEditor, Display, TEXT("Imported %d of %d GIF files in %.2f sec, %d failed"), Jobs.Num() - NumFailed, Jobs.Num(), TotalTime, NumFailed);
+
+	if (!ReportPath.IsEmpty())
+	{
+		FString Report = TEXT("file,package,status,error,read_ms,parse_ms,create_ms,save_ms\n");
+		for (const FAnimatedTextureImportJob& Job : Jobs)
+		{
+			Report += FString::Printf(TEXT("\"%s\",%s,%s,\"%s\",%.2f,%.2f,%.2f,%.2f\n"),
+				*Job.Filename, *Job.PackageName, Job.Error.IsEmpty() ? TEXT("ok") : TEXT("failed"), *Job.Error,
+				Job.ReadTime * 1000.0, Job.ParseTime * 1000.0, Job.CreateTime * 1000.0, Job.SaveTime * 1000.0);
+		}// end of for
+
+		if (!FFileHelper::SaveStringToFile(Report, *ReportPath))
+			UE_LOG(LogAnimTextureEditor, Error, TEXT("Unable to write %s"), *ReportPath);
+	}
+
+	return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"	// Engine
+
+#include "AnimatedTextureBenchmarkCommandlet.generated.h"
+
+/**
+ * Measures GIF parsing, LZW decoding, frame compositing and block compression on a generated corpus, no GPU involved,
+ * and fails if the LZW decoder does not match gif_load byte for byte or the block encoder loses too much:
+ *	UE4Editor-Cmd <Project> -run=AnimatedTextureBenchmark -nullrhi [-filter=<case>] [-mintime=<sec>] [-label=<build>] [-output=<path>]
+ * Results go to <path>.json and <path>.csv, Saved/AnimatedTexture/Benchmark-<date> by default.
+ */
+UCLASS()
+class ANIMATEDTEXTUREEDITOR_API UAnimatedTextureBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAnimatedTextureBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	//~ Begin UCommandlet Interface.
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface.
+};
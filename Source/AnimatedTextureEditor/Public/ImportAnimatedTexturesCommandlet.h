@@ -0,0 +1,35 @@
+/**
+ * Copyright 2019 Neil Fang. All Rights Reserved.
+ *
+ * Animated Texture from GIF file
+ *
+ * Created by Neil Fang
+ * GitHub Repo: https://github.com/neil3d/UnrealAnimatedTexturePlugin
+ * GitHub Page: http://neil3d.github.io
+ *
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"	// Engine
+#include "ImportAnimatedTexturesCommandlet.generated.h"
+
+/**
+ * Import a folder of GIF files as animated texture assets:
+ *	UE4Editor-Cmd <Project> -run=ImportAnimatedTextures -source=<dir> -dest=/Game/<path> [-norecursive] [-batch=<files>] [-report=<csv>]
+ * Files are read and parsed on worker threads, the game thread only creates and saves the assets.
+ * Sub folders of source become sub folders of dest, existing assets are overwritten.
+ */
+UCLASS()
+class ANIMATEDTEXTUREEDITOR_API UImportAnimatedTexturesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UImportAnimatedTexturesCommandlet(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	//~ Begin UCommandlet Interface.
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface.
+};